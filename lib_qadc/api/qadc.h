@@ -6,43 +6,14 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <xccompat.h>
-#ifdef __XC__
-#define UNSAFE unsafe
-#else
+#ifndef __XC__
 #include <xcore/parallel.h>
 #include <xcore/channel.h>
 #include <xcore/port.h>
-#define UNSAFE
 #endif
+#include "qadc_types.h"
 
 
-/** 
- * @brief   Configuration structure for initialising the QADC. This contains
- *          the passive component definition, voltages, conversion speed ( adc_xxx_task() only ) 
- *          and mode.
- */
-typedef struct qadc_config_t{
-    /** Capacitor size in picofarads. Should include the stray capacitance of the PCB. */
-    unsigned capacitor_pf;
-    /** Potentiometer value in ohms - nominal maximum value end to end. */
-    unsigned potentiometer_ohms;
-    /** Series resistor size in ohms. */
-    unsigned resistor_series_ohms;
-    /** Voltage of the IO rail used by the QADC port as a float. */
-    float v_rail;
-    /** Voltage of the input threshold. This is nominally 1.15 volts for a 3.3 volt rail. */
-    float v_thresh;
-    /** Boolean setting which allows the largest time seen by the conversion to be trimmed if it
-     *  exceeds the expected value. The new end point will be kept until the task is re-started. 
-     *  It can account for cases where the RC delay constant is much larger than expected. 
-     *  Note no scheme is available for detecting the case where the RC constant is shorter 
-     *  than expected. */ 
-    char auto_scale;
-    /** The full conversion cycle time per channel (adc_xxx_task() only). The task will assert
-     *  at initialisation if this is too short. This setting is ignored in single-shot mode.*/    
-    unsigned convert_interval_ticks;
-}qadc_config_t;
-
 /**
  * \addtogroup lib_qadc_common
  *
@@ -52,9 +23,11 @@ typedef struct qadc_config_t{
 
 /** @brief Read an ADC channel, arg: channel number in LSB. Please OR the cmd with the operand. */
 #define QADC_CMD_READ                0x01000000ULL
-/** @brief Start calibration mode. Move the potentiometer end to end to determine limits. */
+/** @brief Start calibration mode. Move the potentiometer end to end to determine limits.
+ *  The potentiometer reader asserts unless a buffer was attached with qadc_pot_attach_cal_buffer(). */
 #define QADC_CMD_CAL_MODE_START      0x02000000ULL
-/** @brief Stop calibration mode and use new observed limits. */
+/** @brief Stop calibration mode and use new observed limits. Conversion continues while the potentiometer LUT is
+ *  rebuilt and the new LUT is used once complete. */
 #define QADC_CMD_CAL_MODE_FINISH     0x03000000ULL
 /** @brief Read the conversion direction. Potentiometer QADC only. (1 = High to low, 0 = Low to high) of an ADC channel, arg: channel number in LSB.  Please OR the cmd with the operand.*/
 #define QADC_CMD_POT_GET_DIR         0x04000000ULL
@@ -64,19 +37,54 @@ typedef struct qadc_config_t{
 #define QADC_CMD_START_CONV          0x06000000ULL
 /** @brief Exit the qadc_pot_task(). */
 #define QADC_CMD_EXIT                0x07000000ULL
+/** @brief Read all channels in one transaction. Use qadc_read_all() which sends this and collects the reply. */
+#define QADC_CMD_READ_ALL            0x08000000ULL
+/** @brief Start streaming. The task counts full scans of the channels from now on, see qadc_stream_read(). */
+#define QADC_CMD_STREAM_START        0x09000000ULL
+/** @brief Read the stream frame, replied to straight away. Use qadc_stream_read() which sends this and collects the reply. */
+#define QADC_CMD_STREAM_READ         0x0a000000ULL
+/** @brief Stop streaming. */
+#define QADC_CMD_STREAM_STOP         0x0b000000ULL
+/** @brief Subscribe to change notifications on a channel. Use qadc_subscribe() which sends this and its operand. */
+#define QADC_CMD_SUBSCRIBE           0x0c000000ULL
+/** @brief Read the pending notifications, replied to straight away. Use qadc_notify_read() which sends this and collects the reply. */
+#define QADC_CMD_NOTIFY_READ         0x0d000000ULL
+/** @brief Read the instance statistics. Use qadc_get_stats() which sends this and collects the reply. */
+#define QADC_CMD_GET_STATS           0x0e000000ULL
+/** @brief OR with QADC_CMD_GET_STATS to clear the statistics once read. */
+#define QADC_STATS_RESET             0x00000001ULL
 /** @brief Mask word used for building commands */
 #define QADC_CMD_MASK                0xff000000ULL
 
+/** @brief Tag word sent ahead of each stream frame. The number of channels in the frame, zero if there has been
+ *  no new scan, is in the QADC_RESULT_MASK bits and the number of scans since the previous frame at QADC_STREAM_SCANS_SHIFT. */
+#define QADC_STREAM_FRAME_HEADER     0xa5000000ULL
+/** @brief Shift of the scan count in a stream frame header. */
+#define QADC_STREAM_SCANS_SHIFT      16
+/** @brief The scan count in a stream frame header saturates at this value. */
+#define QADC_STREAM_MAX_SCANS        0xff
+/** @brief Mask for the conversion result in each word of a READ_ALL reply or stream frame. */
+#define QADC_RESULT_MASK             0x0000ffffULL
+/** @brief Shift of the conversion direction in each word of a READ_ALL reply or stream frame. Potentiometer QADC only. */
+#define QADC_RESULT_DIR_SHIFT        16
+/** @brief Tag word sent ahead of each notification. The number of notifications that follow is in the LSBs. */
+#define QADC_NOTIFY_FRAME_HEADER     0xa6000000ULL
+/** @brief Shift of the channel number in each notification word. The result is in the QADC_RESULT_MASK bits. */
+#define QADC_NOTIFY_CH_SHIFT         16
+#ifndef QADC_NOTIFY_MAX_CH
+/** @brief Channels which may be subscribed to per QADC task. Each costs 12 bytes of task stack. */
+#define QADC_NOTIFY_MAX_CH           16
+#endif
+#if QADC_NOTIFY_MAX_CH > 32
+#error QADC_NOTIFY_MAX_CH must be no more than 32
+#endif
+/** @brief Word pushed on the channel attached with qadc_pot_attach_push() or qadc_rheo_attach_push() when change
+ *  notifications are waiting to be collected with qadc_notify_read(). */
+#define QADC_PUSH_NOTIFY             0xa7000000ULL
+/** @brief Word pushed on the channel attached with qadc_pot_attach_push() or qadc_rheo_attach_push() when a stream
+ *  frame is waiting to be collected with qadc_stream_read(). */
+#define QADC_PUSH_STREAM             0xa8000000ULL
 
-/** 
- * @brief   Fixed point type used internally by QADC.
- */
-typedef uint16_t         qadc_q3_13_fixed_t;
-
-/** 
- * @brief   The shift value needed to work with qadc_q3_13_fixed_t
- */
-#define QADC_Q_3_13_SHIFT    13
 
 /**
  * Perform xcore resource setup if QADC is to be used from C with lib_xcore PAR_JOBS().
@@ -90,8 +98,145 @@ typedef uint16_t         qadc_q3_13_fixed_t;
 void qadc_pre_init_c(port p_adc[], size_t num_adc);
 
 
+/**
+ * Read the results of all channels from a running qadc_pot_task() or qadc_rheo_task() using one command
+ * and a single block transfer rather than a round trip per channel. Each word holds the result in the
+ * QADC_RESULT_MASK bits and, for the potentiometer QADC, the conversion direction at QADC_RESULT_DIR_SHIFT.
+ *
+ * \param c_adc          The channel connected to the QADC task.
+ * \param results        Array of num_adc words to receive the results.
+ * \param num_adc        The number of channels the QADC task was initialised with.
+ */
+void qadc_read_all(chanend c_adc, uint32_t results[], size_t num_adc);
+
+/**
+ * Read the next stream frame from a qadc_pot_task(), qadc_rheo_task() or qadc_mixed_task() which has been sent
+ * QADC_CMD_STREAM_START. The task replies straight away. If at least one full scan of the channels has completed
+ * since the previous frame the results are copied to results, in the same format as qadc_read_all(), otherwise
+ * results is left unchanged.
+ *
+ * With a push channel attached using qadc_pot_attach_push() or qadc_rheo_attach_push(), the task outputs
+ * QADC_PUSH_STREAM on it at the end of the first scan after QADC_CMD_STREAM_START and after each call, so the
+ * client selects on the push channel, inputs the word and then calls this to collect the frame without
+ * polling. A word pushed before QADC_CMD_STREAM_STOP may be followed by a frame with no new scan. Without a push
+ * channel, call this at least once per scan to see every scan.
+ *
+ * The task only ever sends on the channel in reply to a command so this may be freely mixed with any other
+ * commands, including qadc_notify_read().
+ *
+ * \param c_adc          The channel connected to the QADC task.
+ * \param results        Array of num_adc words to receive the results.
+ * \param num_adc        The number of channels the QADC task was initialised with.
+ * \returns              The number of scans completed since the previous frame, saturating at
+ *                       QADC_STREAM_MAX_SCANS. Zero if there is no new scan, more than one if any were missed.
+ */
+unsigned qadc_stream_read(chanend c_adc, uint32_t results[], size_t num_adc);
+
+/**
+ * Subscribe to change notifications for one channel of a running qadc_pot_task() or qadc_rheo_task(). At the
+ * end of each scan the task marks the channel pending when the filtered result, after hysteresis, has moved by
+ * at least delta from the last value notified for that channel. The pending channels are collected with
+ * qadc_notify_read(). Subscribing sets the reference value to the current result and clears any pending
+ * notification for the channel.
+ *
+ * \param c_adc              The channel connected to the QADC task.
+ * \param adc_idx            The channel to subscribe to. Must be less than QADC_NOTIFY_MAX_CH.
+ * \param delta              The change in result which causes a notification. Zero unsubscribes.
+ * \param min_interval_ticks The minimum time in 100MHz ticks between notifications for this channel.
+ */
+void qadc_subscribe(chanend c_adc, unsigned adc_idx, uint16_t delta, uint32_t min_interval_ticks);
+
+/**
+ * Collect the pending change notifications. The task replies straight away with a QADC_NOTIFY_FRAME_HEADER
+ * word followed by one word per channel which has qualified since the previous call, holding the channel
+ * number at QADC_NOTIFY_CH_SHIFT and its latest result in the QADC_RESULT_MASK bits. Each notified result
+ * becomes the reference for that channel's next notification.
+ *
+ * The task only ever sends on the channel in reply to a command so this may be freely mixed with any other
+ * commands, including qadc_stream_read(). Streaming and notifications are independent and each reply answers
+ * only its own request.
+ *
+ * Rather than calling this periodically, the client can wait for the task to tell it a notification is
+ * pending. With a push channel attached using qadc_pot_attach_push() or qadc_rheo_attach_push(), the task
+ * outputs QADC_PUSH_NOTIFY on it once when a channel first qualifies, and not again until this has been
+ * called. The client selects on the push channel, inputs the word and then calls this.
+ *
+ * \param c_adc              The channel connected to the QADC task.
+ * \param notifications      Array to receive the notification words.
+ * \param max_notifications  The size of notifications. The number of subscribed channels is always enough.
+ * \returns                  The number of notification words received. Zero if nothing has moved.
+ */
+size_t qadc_notify_read(chanend c_adc, uint32_t notifications[], size_t max_notifications);
+
+/**
+ * Read the runtime statistics of a running qadc_pot_task() or qadc_rheo_task() which has a qadc_stats_t
+ * attached using qadc_pot_attach_stats() or qadc_rheo_attach_stats(). The statistics are all zero if none
+ * is attached. Clients on the same tile may also read the attached qadc_stats_t directly.
+ *
+ * \param c_adc          The channel connected to the QADC task.
+ * \param stats          Receives a copy of the statistics.
+ * \param reset          If non-zero the task clears its statistics once they have been sent.
+ */
+void qadc_get_stats(chanend c_adc, REFERENCE_PARAM(qadc_stats_t, stats), int reset);
+
+/**
+ * Take a consistent copy of the latest complete scan from a qadc_mailbox_t attached to a QADC task using
+ * qadc_pot_attach_mailbox() or qadc_rheo_attach_mailbox(). The copy never mixes results from different scans.
+ * The reader must be on the same tile as the QADC task. This does not block the task and only waits if
+ * called while the task is publishing, which takes a few instructions per channel.
+ *
+ * The snapshot also holds each channel's conversion timestamp and, in new_data_mask, which channels'
+ * results changed since the previous call with the same snapshot. Zero initialise the snapshot before the
+ * first call, after which all channels are reported as new.
+ *
+ * \param mailbox        The mailbox attached to the QADC task.
+ * \param snapshot       The reader's snapshot which is updated with the latest scan.
+ * \returns              Non-zero if a new scan has been published since the previous call.
+ */
+int qadc_mailbox_read(REFERENCE_PARAM(const qadc_mailbox_t, mailbox), REFERENCE_PARAM(qadc_mailbox_snapshot_t, snapshot));
+
+/** @brief PWM period used by qadc_find_threshold() in 100 MHz port clock ticks. Sets the voltage resolution
+ *  to v_rail divided by this. */
+#ifndef QADC_THRESH_PWM_PERIOD_TICKS
+#define QADC_THRESH_PWM_PERIOD_TICKS    256
+#endif
+
+/** @brief Settling time per step of qadc_find_threshold() for the resistor and capacitor at the pin. Five
+ *  RC time constants in 100 MHz timer ticks. */
+#define QADC_THRESH_SETTLE_TICKS(r_ohms, c_pf)    ((uint32_t)(r_ohms) * (c_pf) / 2000)
+
+/**
+ * Measure the input threshold voltage of an IO pin, for use as v_thresh in the qadc_config_t passed to
+ * qadc_pot_init() or qadc_rheo_init(). Call it before initialising the QADC so the LUT and timings are built
+ * for the measured threshold rather than the nominal one, which removes a systematic error in the
+ * conversion curve.
+ *
+ * The pin drives a PWM into a capacitor through a resistor and a binary search finds the duty cycle at
+ * which the pin reads a one, once approaching from zero and once from the rail. The result is the
+ * average of the rising and falling thresholds with a resolution of v_rail / QADC_THRESH_PWM_PERIOD_TICKS.
+ * Each search takes eight steps of twice settle_ticks, so a pin is measured in a few milliseconds for an
+ * RC time constant in the tens of microseconds.
+ *
+ * The RC time constant at the pin must be long compared with the PWM period, at least 20 microseconds,
+ * and nothing else may pull the pin, so use a spare pin with its own resistor and capacitor in the
+ * same IO supply domain as the QADC pins. The QADC pins themselves are normally not suitable because the
+ * potentiometer or rheostat loads the capacitor and the series resistor gives too short a time constant.
+ * A port drives all of its pins whenever it outputs, so other pins of a multi-bit port are driven at the
+ * levels they read when the measurement starts until it finishes. The port is left high impedance.
+ *
+ * \param p_adc          The port of the pin to measure, clocked from the 100 MHz reference clock.
+ * \param bit_idx        The pin within the port. Zero for a 1-bit port.
+ * \param v_rail         Voltage of the IO rail.
+ * \param settle_ticks   Time for the capacitor to settle after each change of duty cycle in 100 MHz
+ *                       ticks. Use QADC_THRESH_SETTLE_TICKS() for the components at the pin.
+ * \returns              The threshold voltage, or zero if the pin never changed state during the search.
+ */
+float qadc_find_threshold(port p_adc, unsigned bit_idx, float v_rail, uint32_t settle_ticks);
+
+
 /**@}*/ // END: addtogroup lib_qadc_common
 
 
 #include "qadc_pot.h"
-#include "qadc_rheo.h"
\ No newline at end of file
+#include "qadc_rheo.h"
+#include "qadc_mixed.h"
\ No newline at end of file
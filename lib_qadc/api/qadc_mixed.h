@@ -0,0 +1,87 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#pragma once
+#include "qadc.h"
+
+#ifndef QADC_MIXED_MAX_CH
+/**
+ * @brief   Most channels, potentiometer and rheostat together, supported by qadc_mixed_task(). Each costs
+ *          4 bytes of qadc_mixed_state_t.
+ */
+#define QADC_MIXED_MAX_CH       16
+#endif
+
+/**
+ * @brief   Internal state for a mixed reader. These should not be accessed directly and instead
+ *          be initialised by a call to qadc_mixed_init().
+ */
+typedef struct qadc_mixed_state_t{
+    qadc_pot_state_t * UNSAFE pot_state;
+    qadc_rheo_state_t * UNSAFE rheo_state;
+    size_t num_pot;
+    size_t num_adc;
+    uint16_t results[QADC_MIXED_MAX_CH];
+    uint16_t dirs[QADC_MIXED_MAX_CH];
+}qadc_mixed_state_t;
+
+
+
+/**
+ * \addtogroup lib_qadc_mixed_reader
+ *
+ * The public API for converting potentiometers and rheostats from one task.
+ * @{
+ */
+
+/**
+ * Initialise a mixed reader which converts the channels of a potentiometer instance and a rheostat instance
+ * from a single task with a single command channel, saving the thread and channel end of a second task.
+ * Initialise both instances first using qadc_pot_init() and qadc_rheo_init(), attaching any mailbox,
+ * statistics block or calibration buffer as usual. Both must use QADC_CONVERT_SEQUENTIAL.
+ *
+ * The channels are numbered with the potentiometer channels first followed by the rheostat channels, so
+ * with two potentiometers the first rheostat is channel 2. This numbering is used by all commands and
+ * by the results sent to the client. Each instance keeps its own results, scaling and filter so the
+ * instance's state buffer, and any mailbox attached to it, still holds its own channels only.
+ *
+ * \param mixed_state    The mixed reader state to initialise.
+ * \param adc_pot_state  The potentiometer instance initialised by qadc_pot_init().
+ * \param adc_rheo_state The rheostat instance initialised by qadc_rheo_init().
+ */
+void qadc_mixed_init(REFERENCE_PARAM(qadc_mixed_state_t, mixed_state),
+                    REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state),
+                    REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+
+#if defined(__XC__) || defined(__DOXYGEN__)
+void qadc_mixed_task(NULLABLE_RESOURCE(chanend, c_adc), port p_pot[], port p_rheo[], REFERENCE_PARAM(qadc_mixed_state_t, mixed_state));
+#else
+DECLARE_JOB(qadc_mixed_task, (chanend_t, port_t*, port_t*, qadc_mixed_state_t*));
+/**
+ * Starts a task that will continuously cycle through the channels of both instances, potentiometers first,
+ * and convert each in turn. Each channel's slot lasts for the convert_interval_ticks of its own instance.
+ * The task applies the same post processing as qadc_pot_task() and qadc_rheo_task() would.
+ *
+ * The task accepts the same commands as qadc_pot_task() with the combined channel numbering.
+ * QADC_CMD_POT_GET_DIR returns zero for rheostat channels. The calibration commands apply to the rheostat
+ * instance and, if it has a calibration buffer attached, to the potentiometer instance.
+ * qadc_get_stats() returns only one statistics block: that of the potentiometer instance or, if it has none
+ * attached, that of the rheostat instance. The blocks are not merged because their channel numbering and
+ * histogram scales differ. To see both, attach both and read the rheostat block directly from the same tile.
+ * Stream frames and change notifications are signalled on the channel attached to the potentiometer instance
+ * with qadc_pot_attach_push() or, if it has none, that attached to the rheostat instance.
+ * Optionally, a NULL parameter can be passed to the channel, in which case the results are read from each
+ * instance's state buffer or mailbox.
+ *
+ * qadc_mixed_init() must be called before this task is started.
+ *
+ * \param c_adc         Channel for collecting results and controlling the QADC.
+ * \param p_pot         The ports of the potentiometer instance.
+ * \param p_rheo        The ports of the rheostat instance.
+ * \param mixed_state   The mixed reader state initialised by qadc_mixed_init().
+ */
+void qadc_mixed_task(chanend_t c_adc, port_t *p_pot, port_t *p_rheo, qadc_mixed_state_t *mixed_state);
+#endif
+
+/**@}*/ // END: addtogroup lib_qadc_mixed_reader
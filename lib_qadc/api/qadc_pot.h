@@ -12,24 +12,27 @@ typedef struct qadc_pot_state_t{
     size_t num_adc;
     unsigned port_width;
     unsigned adc_idx;
-    size_t lut_size;
-    size_t filter_depth;
     unsigned result_hysteresis;
     uint16_t * UNSAFE results;
     qadc_config_t adc_config;
-    uint16_t * UNSAFE lut_up;
-    uint16_t * UNSAFE lut_down;
-    uint32_t max_lut_ticks_up;
-    uint32_t max_lut_ticks_down;
+    qadc_pot_lut_t lut;
     uint16_t * UNSAFE max_seen_ticks_up;
     uint16_t * UNSAFE max_seen_ticks_down;
     qadc_q3_13_fixed_t * UNSAFE max_scale_up;
     qadc_q3_13_fixed_t * UNSAFE max_scale_down;
-    unsigned crossover_idx;
-    uint16_t * UNSAFE conversion_history;
+    qadc_filter_t filter;
     uint16_t * UNSAFE hysteris_tracker;
+    uint16_t * UNSAFE raw_results;
+    uint32_t batch_pending;
+    uint32_t batch_up;
+    uint32_t batch_positions;
+    qadc_mailbox_t * UNSAFE mailbox;
+    qadc_stats_t * UNSAFE stats;
+    unsigned c_push;
+    qadc_pot_cal_t cal;
+    qadc_single_state_t single;
+    qadc_event_state_t event;
     uint16_t * UNSAFE init_port_val;
-    uint16_t * UNSAFE filter_write_idx;
 }qadc_pot_state_t;
 
 
@@ -44,6 +47,8 @@ typedef struct qadc_pot_state_t{
 /** 
  * @brief   Macro for sizing the state array used by QADC. Please declare a state array
  *          (linear array) of uint16_t sized by this macro for passing to qadc_pot_init().
+ *          This sizes for the default moving average filter. Use QADC_POT_STATE_SIZE_WITH_FILTER()
+ *          if another filter type is set in qadc_config_t.
  * 
  *          num_adc - The number of channels.
  * 
@@ -53,15 +58,34 @@ typedef struct qadc_pot_state_t{
  *          filter_depth - The depth of the moving average filter (1 to n). Has a large impact on the memory requirements
  *          because each channel requires it's own filter.
  */
-#define QADC_POT_STATE_SIZE(num_adc, lut_size, filter_depth)             (( \
+#define QADC_POT_STATE_SIZE(num_adc, lut_size, filter_depth) \
+    QADC_POT_STATE_SIZE_WITH_FILTER(num_adc, lut_size, QADC_FILTER_MOVING_AVERAGE, filter_depth)
+
+/** 
+ * @brief   Macro for sizing the state array used by QADC for a given filter type. The IIR based filters
+ *          need no history so the state does not grow with filter_depth.
+ * 
+ *          filter_type - The qadc_filter_type_t set in the qadc_config_t passed to qadc_pot_init().
+ */
+#define QADC_POT_STATE_SIZE_WITH_FILTER(num_adc, lut_size, filter_type, filter_depth)        (( \
+    /* compact cal table */  (sizeof(uint16_t) * lut_size) +                \
+                             (sizeof(uint16_t) * QADC_POT_STATE_SIZE_SHARED_LUT(num_adc, filter_type, filter_depth)) + \
+                             (sizeof(uint16_t) - 1)) / sizeof(uint16_t))
+
+/** 
+ * @brief   Macro for sizing the state array used by QADC when the look up table is not held in the state
+ *          buffer, for use with qadc_pot_init_shared_lut().
+ * 
+ *          filter_type - The qadc_filter_type_t set in the qadc_config_t passed to qadc_pot_init_shared_lut().
+ */
+#define QADC_POT_STATE_SIZE_SHARED_LUT(num_adc, filter_type, filter_depth)        (( \
     /* results */            (sizeof(uint16_t) * num_adc) +                 \
     /* init_port_val */      (sizeof(uint16_t) * num_adc) +                 \
-    /* conversion_history */ (sizeof(uint16_t) * num_adc * filter_depth) +  \
     /* hysteris_tracker */   (sizeof(uint16_t) * num_adc) +                 \
     /* max_seen_ticks u/d */ (sizeof(uint16_t) * num_adc * 2) +             \
     /* max_scale u/d */      (sizeof(uint16_t) * num_adc * 2) +             \
-    /* cal up + cal down */  (sizeof(uint16_t) * 2 * lut_size) +            \
-    /* filter_write_idx */   (sizeof(uint16_t) * num_adc) +                 \
+    /* raw_results */        (sizeof(uint16_t) * num_adc) +                 \
+    /* filter */             (sizeof(uint16_t) * QADC_FILTER_STATE_SIZE(num_adc, filter_type, filter_depth)) + \
                              (sizeof(uint16_t) - 1)) / sizeof(uint16_t))
 
 
@@ -76,8 +100,10 @@ typedef struct qadc_pot_state_t{
  * \param num_adc       The number of ADC channels needed. Where ports other than 1b ports are used, the lower pins
  *                      on the port are used first. Eg. bottom 2 pins of a 4b port are used if num_adc = 2. The other
  *                      pins on the port are reserved.
- * \param lut_size      The size of the look up table. Also sets the output result full scale value to lut_size - 1.
- * \param filter_depth  The size of the moving average filter used to average each conversion result. 
+ * \param lut_size      The size of the look up table. Also sets the output result full scale value to lut_size - 1,
+ *                      shifted up by result_frac_bits of adc_config.
+ * \param filter_depth  The size of the moving average filter used to average each conversion result. For the IIR
+ *                      filter types this sets the time constant in conversions.
  * \param state_buffer  pointer to the state buffer used of type uint16_t. Please use the ADC_POT_STATE_SIZE
  *                      macro to size the declaration of this state buffer.
  * \param adc_config    A struct of type qadc_config_t containing the parameters of the QADC external components
@@ -94,6 +120,51 @@ void qadc_pot_init( port p_adc[],
                     qadc_config_t adc_config,
                     REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
 
+/**
+ * Generate a potentiometer look up table at runtime into a caller supplied buffer so that it can be shared
+ * by several QADC instances with the same passive components using qadc_pot_init_shared_lut(). The buffer
+ * and descriptor must remain valid for as long as any instance uses them.
+ *
+ * \param lut           The descriptor to initialise.
+ * \param lut_buffer    Buffer of QADC_POT_LUT_BUFFER_SIZE(lut_size) uint16_t entries which will hold the table.
+ * \param lut_size      The size of the look up table. Also sets the output result full scale value to lut_size - 1,
+ *                      shifted up by result_frac_bits of adc_config.
+ * \param adc_config    The passive component definition. Only the component values and voltages are used.
+ */
+void qadc_pot_lut_init( REFERENCE_PARAM(qadc_pot_lut_t, lut),
+                        uint16_t *lut_buffer,
+                        size_t lut_size,
+                        qadc_config_t adc_config);
+
+/**
+ * Initialise a QADC potentiometer reader instance which uses an existing look up table rather than generating
+ * one in its state buffer. The table may come from qadc_pot_lut_init() or be a const table generated offline
+ * by tools/qadc_pot_lut_gen, in which case initialisation does no floating point work at all. The table
+ * must have been generated for the same passive components and voltages as adc_config.
+ * 
+ * Otherwise identical to qadc_pot_init().
+ *
+ * \param p_adc         An array of ports used for conversion. Must all be of same time (eg. 1b or 4b ports)
+ * \param num_adc       The number of ADC channels needed.
+ * \param lut           The shared look up table descriptor. This is copied so only the tables it points to need
+ *                      to remain valid.
+ * \param filter_depth  The size of the moving average filter used to average each conversion result. For the IIR
+ *                      filter types this sets the time constant in conversions.
+ * \param state_buffer  pointer to the state buffer used of type uint16_t. Please use the QADC_POT_STATE_SIZE_SHARED_LUT
+ *                      macro to size the declaration of this state buffer.
+ * \param adc_config    A struct of type qadc_config_t containing the parameters of the QADC external components
+ *                      and conversion rate / mode.
+ * \param adc_pot_state Reference to the qadc_pot_state_t struct which contains internal state for the QADC.
+ */ 
+void qadc_pot_init_shared_lut(  port p_adc[],
+                                size_t num_adc,
+                                REFERENCE_PARAM(const qadc_pot_lut_t, lut),
+                                size_t filter_depth,
+                                unsigned result_hysteresis,
+                                uint16_t *state_buffer,
+                                qadc_config_t adc_config,
+                                REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
 
 /**
  * Perform a single ADC conversion on a specific channel. In this mode the QADC does not require a dedicated
@@ -110,7 +181,182 @@ void qadc_pot_init( port p_adc[],
  */ 
 uint16_t qadc_pot_single(port p_adc[], unsigned adc_idx, REFERENCE_PARAM(qadc_pot_state_t, qadc_pot_state));
 
+/**
+ * Start a split-phase single conversion on a specific channel. Unlike qadc_pot_single() this returns as soon as
+ * the channel has started charging, so the caller can carry on with other work and collect the result later
+ * using qadc_pot_single_poll() and qadc_pot_single_complete(). Only one conversion may be in progress per
+ * instance. If the previous conversion on this instance has not yet settled this waits for the remainder of
+ * the settling time, which is normally over by the time the next conversion is started.
+ * qadc_pot_init() must be called before this function. Callable from C.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param adc_idx        The QADC channel to read.
+ * \param qadc_pot_state Reference to the qadc_pot_state_t struct which contains internal state for the QADC. 
+ */ 
+void qadc_pot_single_start(port p_adc[], unsigned adc_idx, REFERENCE_PARAM(qadc_pot_state_t, qadc_pot_state));
+
+/**
+ * Advance a conversion started by qadc_pot_single_start() without blocking. Call this periodically, for
+ * example from a timer case in a select or from a control loop. The conversion end is timestamped by the
+ * port hardware so the result does not depend on how promptly this is called, provided it is called
+ * within a few hundred microseconds of the conversion ending. Releasing the capacitor once charged
+ * is done here, so a late call only lengthens the charge time.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param qadc_pot_state Reference to the qadc_pot_state_t struct which contains internal state for the QADC.
+ * \returns              Non-zero once the result is ready.
+ */
+int qadc_pot_single_poll(port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, qadc_pot_state));
+
+/**
+ * Return the result of a conversion started by qadc_pot_single_start(), waiting for it to finish if
+ * qadc_pot_single_poll() has not already reported it ready.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param qadc_pot_state Reference to the qadc_pot_state_t struct which contains internal state for the QADC.
+ * \returns              The post processed conversion result.
+ */
+uint16_t qadc_pot_single_complete(port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, qadc_pot_state));
+
+/**
+ * Start the event driven conversion engine on a QADC instance, for driving conversions from a select loop,
+ * event handler or interrupt callback owned by the application rather than from a dedicated task. The
+ * engine converts each channel in turn, one per convert_interval_ticks, with the same post processing,
+ * mailbox and statistics as qadc_pot_task(). It only needs servicing at the time returned by
+ * qadc_pot_event_time() and when the port given by qadc_pot_event_port() meets its condition, each of which
+ * takes a few microseconds. The instance must use QADC_CONVERT_SEQUENTIAL.
+ * qadc_pot_init() must be called before this function. Callable from C.
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ */
+void qadc_pot_event_start(port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
+/**
+ * Stop the event driven conversion engine, abandoning any conversion in progress and leaving the ports Hi-Z.
+ * Restart it using qadc_pot_event_start().
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_pot_state The QADC state.
+ */
+void qadc_pot_event_stop(port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
+/**
+ * Return the reference timer value at which qadc_pot_event_timer() must next be called. This changes after
+ * each call to qadc_pot_event_timer() or qadc_pot_event_pins() so re-arm the timer after each.
+ *
+ * \param adc_pot_state The QADC state.
+ * \returns             The time of the next timer event.
+ */
+int32_t qadc_pot_event_time(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
+/**
+ * Find out whether the engine is waiting for a port event. When it is, wait for the port p_adc[port_idx] to read a value other than pin_value, for example using pinsneq() or port_set_trigger_in_not_equal(), then call
+ * qadc_pot_event_pins() with the port timestamp. Check again after each call to qadc_pot_event_timer() or
+ * qadc_pot_event_pins().
+ *
+ * \param adc_pot_state The QADC state.
+ * \param port_idx      Set to the index in p_adc of the port to wait on.
+ * \param pin_value     Set to the value which the port must differ from.
+ * \returns             Non-zero if a port event is needed.
+ */
+int qadc_pot_event_port(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), REFERENCE_PARAM(unsigned, port_idx), REFERENCE_PARAM(unsigned, pin_value));
+
+/**
+ * Service the timer event. Call once the time returned by qadc_pot_event_time() has passed. Calling early
+ * does nothing. Releases the capacitor, starts charging the next channel or completes a conversion which
+ * has overshot, as due.
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_pot_state The QADC state.
+ * \returns             Non-zero when this completed a scan of all channels.
+ */
+int qadc_pot_event_timer(port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
+/**
+ * Service the port event requested by qadc_pot_event_port(). The conversion result is taken from the port
+ * timestamp, so handling the event late does not change the result provided it is within the wrap time
+ * of the 16 bit port timer.
+ *
+ * \param adc_pot_state The QADC state.
+ * \param port_val      The value read from the port.
+ * \param port_time     The port timestamp of the read.
+ * \returns             Non-zero when this completed a scan of all channels.
+ */
+int qadc_pot_event_pins(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), unsigned port_val, int16_t port_time);
+
+/**
+ * Attach a shared memory result mailbox to a QADC instance. The task then publishes each complete scan of
+ * all channels, with a timestamp per channel, for same tile clients to read using qadc_mailbox_read().
+ * Unlike reading the results directly from the state buffer, readers can tell when new data has arrived and
+ * never see a partial scan or the results being cleared by QADC_CMD_START_CONV.
+ * Call after qadc_pot_init() and before starting qadc_pot_task().
+ *
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ * \param mailbox        The mailbox to publish into. Must hold at least num_adc channels, see QADC_MAILBOX_MAX_CH.
+ */
+void qadc_pot_attach_mailbox(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), qadc_mailbox_t *mailbox);
+
+/**
+ * Attach a statistics block to a QADC instance. The task then counts conversions and overshoots, tracks the
+ * range and distribution of conversion times and records worst case post processing time and timing slack
+ * so that convert_interval_ticks and the filter settings can be tuned from measurements. Read it using
+ * qadc_get_stats() or, on the same tile, directly. Without a statistics block attached the task does none
+ * of this work. Call after qadc_pot_init() and before starting qadc_pot_task().
+ *
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ * \param stats         The statistics block to update. It is cleared by this call.
+ */
+void qadc_pot_attach_stats(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), qadc_stats_t *stats);
+
+/**
+ * Attach a push channel to a QADC instance so that a client can wait for stream frames and change
+ * notifications rather than polling for them. The task outputs a single QADC_PUSH_STREAM word on c_push when
+ * a stream frame is ready, and not again until it has been collected with qadc_stream_read(). Likewise it
+ * outputs a single QADC_PUSH_NOTIFY word when notifications are pending, and not again until they have been
+ * collected with qadc_notify_read(). Both are collected over the command channel as usual. The words are sent
+ * without a handshake and at most two are ever outstanding, so the task never waits for the client. The client
+ * should input each word before collecting, and input nothing else on the channel. Call after qadc_pot_init()
+ * and before starting qadc_pot_task().
+ *
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ * \param c_push        One end of a streaming channel which only the task outputs on. The client inputs
+ *                      from the other end.
+ */
+void qadc_pot_attach_push(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), streaming_chanend_t c_push);
+
+
+/**
+ * Attach a calibration buffer to a QADC instance, which enables QADC_CMD_CAL_MODE_START and
+ * QADC_CMD_CAL_MODE_FINISH. After QADC_CMD_CAL_MODE_START the task records the longest conversion seen in each
+ * direction while the potentiometers are moved end to end. QADC_CMD_CAL_MODE_FINISH then rebuilds the LUT in
+ * fixed point, scaled to those extremes, a few entries per scan into the half of the buffer not in use, and
+ * swaps it in once complete. Conversions continue throughout using the previous table. The LUT is shared by
+ * all channels so each direction gets one scale, set by the longest time seen on any channel, rather than one
+ * per channel as the rheostat reader has. Sending QADC_CMD_CAL_MODE_START to qadc_pot_task() without a buffer
+ * attached is an error and asserts. Call after qadc_pot_init() or qadc_pot_init_shared_lut() and
+ * before starting qadc_pot_task().
+ *
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ * \param cal_buffer    Buffer of QADC_POT_CAL_BUFFER_SIZE(lut_size) entries.
+ */
+void qadc_pot_attach_cal_buffer(REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state), uint16_t *cal_buffer);
+
 #if defined(__XC__) || defined(__DOXYGEN__)
+/**
+ * A combinable version of qadc_pot_task() which may share a logical core with other combinable tasks. It is
+ * built on the event API so each case only runs for the few microseconds needed to step a conversion.
+ * It accepts the same commands except that QADC_CMD_EXIT, which a combinable task cannot act on by
+ * returning, stops conversion like QADC_CMD_STOP_CONV. The instance must use QADC_CONVERT_SEQUENTIAL.
+ * Only available from XC. From C use the event API directly from the application's own event loop.
+ *
+ * \param c_adc         Channel for collecting results and controlling the QADC. May be null.
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_pot_state The QADC state initialised by qadc_pot_init().
+ */
+[[combinable]]
+void qadc_pot_task_combinable(NULLABLE_RESOURCE(chanend, c_adc), port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
+
 void qadc_pot_task(NULLABLE_RESOURCE(chanend, c_adc), port p_adc[], REFERENCE_PARAM(qadc_pot_state_t, adc_pot_state));
 #else
 DECLARE_JOB(qadc_pot_task, (chanend_t, port_t*, qadc_pot_state_t*));
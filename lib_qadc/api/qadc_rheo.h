@@ -11,7 +11,6 @@
 typedef struct qadc_rheo_state_t{
     size_t num_adc;
     unsigned adc_idx;
-    size_t filter_depth;
     size_t adc_steps;
     unsigned result_hysteresis;
     uint16_t * UNSAFE results;
@@ -20,9 +19,16 @@ typedef struct qadc_rheo_state_t{
     uint16_t * UNSAFE max_seen_ticks;
     qadc_q3_13_fixed_t * UNSAFE max_scale;
     unsigned crossover_idx;
-    uint16_t * UNSAFE conversion_history;
+    qadc_filter_t filter;
     uint16_t * UNSAFE hysteris_tracker;
-    uint16_t * UNSAFE filter_write_idx;
+    uint16_t * UNSAFE raw_results;
+    uint32_t batch_pending;
+    int batch_auto_scale;
+    qadc_mailbox_t * UNSAFE mailbox;
+    qadc_stats_t * UNSAFE stats;
+    unsigned c_push;
+    qadc_single_state_t single;
+    qadc_event_state_t event;
 }qadc_rheo_state_t;
 
 
@@ -36,13 +42,26 @@ typedef struct qadc_rheo_state_t{
  * @{
  */
 
-#define QADC_RHEO_STATE_SIZE( num_adc, filter_depth)                     (( \
+/** 
+ * @brief   Macro for sizing the state array used by QADC. Please declare a state array
+ *          (linear array) of uint16_t sized by this macro for passing to qadc_rheo_init().
+ *          This sizes for the default moving average filter. Use QADC_RHEO_STATE_SIZE_WITH_FILTER()
+ *          if another filter type is set in qadc_config_t.
+ */
+#define QADC_RHEO_STATE_SIZE( num_adc, filter_depth) \
+    QADC_RHEO_STATE_SIZE_WITH_FILTER(num_adc, QADC_FILTER_MOVING_AVERAGE, filter_depth)
+
+/** 
+ * @brief   Macro for sizing the state array used by QADC for a given filter type. The IIR based filters
+ *          need no history so the state does not grow with filter_depth.
+ */
+#define QADC_RHEO_STATE_SIZE_WITH_FILTER( num_adc, filter_type, filter_depth)    (( \
     /* results */            (sizeof(uint16_t) * num_adc) +                 \
-    /* conversion_history */ (sizeof(uint16_t) * num_adc * filter_depth) +  \
     /* hysteris_tracker */   (sizeof(uint16_t) * num_adc) +                 \
     /* max_seen_ticks*/      (sizeof(uint16_t) * num_adc) +                 \
     /* max_scale */          (sizeof(uint16_t) * num_adc) +                 \
-    /* filter_write_idx */   (sizeof(uint16_t) * num_adc) +                 \
+    /* raw_results */        (sizeof(uint16_t) * num_adc) +                 \
+    /* filter */             (sizeof(uint16_t) * QADC_FILTER_STATE_SIZE(num_adc, filter_type, filter_depth)) + \
                              (sizeof(uint16_t) - 1)) / sizeof(uint16_t))
 
 /**
@@ -53,9 +72,12 @@ typedef struct qadc_rheo_state_t{
  * IF CALLING FROM C WITH lib_xcore's PAR_JOBS() TO START THE THREADS, PLEASE CALL qadc_c_pre_init() FIRST.
  *
  * \param p_adc             An array of 1 bit ports used for conversion.
- * \param num_adc           The number of 1 bit ports (QADC channels) used.
- * \param adc_steps         The number of discrete conversion possible values. Also sets the output result full scale value to lut_size - 1.
- * \param filter_depth      The size of the moving average filter used to average each conversion result.   
+ * \param num_adc           The number of 1 bit ports (QADC channels) used. At most QADC_MAX_PORT_WIDTH with
+ *                          QADC_CONVERT_PARALLEL.
+ * \param adc_steps         The number of discrete conversion possible values. Also sets the output result full scale value to adc_steps - 1,
+ *                          shifted up by result_frac_bits of adc_config.
+ * \param filter_depth      The size of the moving average filter used to average each conversion result. For the IIR
+ *                          filter types this sets the time constant in conversions.
  * \param state_buffer      pointer to the state buffer used of type uint16_t. Please use the ADC_POT_STATE_SIZE
  *                          macro to size the declaration of the state buffer.
  * \param adc_config        A struct of type qadc_config_t containing the parameters of the QADC external components
@@ -87,7 +109,161 @@ void qadc_rheo_init(port p_adc[],
  */
 uint16_t qadc_rheo_single(port p_adc[], unsigned adc_idx, REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
 
+/**
+ * Start a split-phase single conversion on a specific channel. Unlike qadc_rheo_single() this returns as soon as
+ * the channel has started charging, so the caller can carry on with other work and collect the result later
+ * using qadc_rheo_single_poll() and qadc_rheo_single_complete(). Only one conversion may be in progress per
+ * instance. If the previous conversion on this instance has not yet settled this waits for the remainder of
+ * the settling time. qadc_rheo_init() must be called before this function. Callable from C.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param adc_idx        The QADC channel to read.
+ * \param adc_rheo_state Reference to the qadc_rheo_state_t struct which contains internal state for the QADC. 
+ */ 
+void qadc_rheo_single_start(port p_adc[], unsigned adc_idx, REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Advance a conversion started by qadc_rheo_single_start() without blocking. The conversion end is timestamped
+ * by the port hardware so the result does not depend on how promptly this is called, provided it is called
+ * within a few hundred microseconds of the conversion ending.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param adc_rheo_state Reference to the qadc_rheo_state_t struct which contains internal state for the QADC.
+ * \returns              Non-zero once the result is ready.
+ */
+int qadc_rheo_single_poll(port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Return the result of a conversion started by qadc_rheo_single_start(), waiting for it to finish if
+ * qadc_rheo_single_poll() has not already reported it ready.
+ *
+ * \param p_adc          An array of ports used for conversion.
+ * \param adc_rheo_state Reference to the qadc_rheo_state_t struct which contains internal state for the QADC.
+ * \returns              The post processed conversion result.
+ */
+uint16_t qadc_rheo_single_complete(port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Start the event driven conversion engine on a QADC instance, for driving conversions from a select loop,
+ * event handler or interrupt callback owned by the application rather than from a dedicated task. The
+ * engine converts each channel in turn, one per convert_interval_ticks, with the same post processing,
+ * mailbox and statistics as qadc_rheo_task(). It only needs servicing at the time returned by
+ * qadc_rheo_event_time() and when the port given by qadc_rheo_event_port() meets its condition, each of which
+ * takes a few microseconds. The instance must use QADC_CONVERT_SEQUENTIAL.
+ * qadc_rheo_init() must be called before this function. Callable from C.
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_rheo_state The QADC state initialised by qadc_rheo_init().
+ */
+void qadc_rheo_event_start(port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Stop the event driven conversion engine, abandoning any conversion in progress and leaving the ports Hi-Z.
+ * Restart it using qadc_rheo_event_start().
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_rheo_state The QADC state.
+ */
+void qadc_rheo_event_stop(port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Return the reference timer value at which qadc_rheo_event_timer() must next be called. This changes after
+ * each call to qadc_rheo_event_timer() or qadc_rheo_event_pins() so re-arm the timer after each.
+ *
+ * \param adc_rheo_state The QADC state.
+ * \returns             The time of the next timer event.
+ */
+int32_t qadc_rheo_event_time(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Find out whether the engine is waiting for a port event. When it is, wait for the port p_adc[port_idx] to read zero, for example using pinseq(0) or port_set_trigger_in_equal(), then call
+ * qadc_rheo_event_pins() with the port timestamp. Check again after each call to qadc_rheo_event_timer() or
+ * qadc_rheo_event_pins().
+ *
+ * \param adc_rheo_state The QADC state.
+ * \param port_idx      Set to the index in p_adc of the port to wait on.
+ * \returns             Non-zero if a port event is needed.
+ */
+int qadc_rheo_event_port(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state), REFERENCE_PARAM(unsigned, port_idx));
+
+/**
+ * Service the timer event. Call once the time returned by qadc_rheo_event_time() has passed. Calling early
+ * does nothing. Releases the capacitor, starts charging the next channel or completes a conversion which
+ * has overshot, as due.
+ *
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_rheo_state The QADC state.
+ * \returns             Non-zero when this completed a scan of all channels.
+ */
+int qadc_rheo_event_timer(port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
+/**
+ * Service the port event requested by qadc_rheo_event_port(). The conversion result is taken from the port
+ * timestamp, so handling the event late does not change the result provided it is within the wrap time
+ * of the 16 bit port timer.
+ *
+ * \param adc_rheo_state The QADC state.
+ * \param port_time     The port timestamp of the read.
+ * \returns             Non-zero when this completed a scan of all channels.
+ */
+int qadc_rheo_event_pins(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state), int16_t port_time);
+
+/**
+ * Attach a shared memory result mailbox to a QADC instance. The task then publishes each complete scan of
+ * all channels, with a timestamp per channel, for same tile clients to read using qadc_mailbox_read().
+ * Unlike reading the results directly from the state buffer, readers can tell when new data has arrived and
+ * never see a partial scan or the results being cleared by QADC_CMD_START_CONV.
+ * Call after qadc_rheo_init() and before starting qadc_rheo_task().
+ *
+ * \param adc_rheo_state The QADC state initialised by qadc_rheo_init().
+ * \param mailbox        The mailbox to publish into. Must hold at least num_adc channels, see QADC_MAILBOX_MAX_CH.
+ */
+void qadc_rheo_attach_mailbox(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state), qadc_mailbox_t *mailbox);
+
+/**
+ * Attach a statistics block to a QADC instance. The task then counts conversions and overshoots, tracks the
+ * range and distribution of conversion times and records worst case post processing time and timing slack
+ * so that convert_interval_ticks and the filter settings can be tuned from measurements. Read it using
+ * qadc_get_stats() or, on the same tile, directly. Without a statistics block attached the task does none
+ * of this work. Call after qadc_rheo_init() and before starting qadc_rheo_task().
+ *
+ * \param adc_rheo_state The QADC state initialised by qadc_rheo_init().
+ * \param stats          The statistics block to update. It is cleared by this call.
+ */
+void qadc_rheo_attach_stats(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state), qadc_stats_t *stats);
+
+/**
+ * Attach a push channel to a QADC instance so that a client can wait for stream frames and change
+ * notifications rather than polling for them. The task outputs a single QADC_PUSH_STREAM word on c_push when
+ * a stream frame is ready, and not again until it has been collected with qadc_stream_read(). Likewise it
+ * outputs a single QADC_PUSH_NOTIFY word when notifications are pending, and not again until they have been
+ * collected with qadc_notify_read(). Both are collected over the command channel as usual. The words are sent
+ * without a handshake and at most two are ever outstanding, so the task never waits for the client. The client
+ * should input each word before collecting, and input nothing else on the channel. Call after qadc_rheo_init()
+ * and before starting qadc_rheo_task().
+ *
+ * \param adc_rheo_state The QADC state initialised by qadc_rheo_init().
+ * \param c_push         One end of a streaming channel which only the task outputs on. The client inputs
+ *                       from the other end.
+ */
+void qadc_rheo_attach_push(REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state), streaming_chanend_t c_push);
+
+
 #if defined(__XC__) || defined(__DOXYGEN__)
+/**
+ * A combinable version of qadc_rheo_task() which may share a logical core with other combinable tasks. It is
+ * built on the event API so each case only runs for the few microseconds needed to step a conversion.
+ * It accepts the same commands except that QADC_CMD_EXIT, which a combinable task cannot act on by
+ * returning, stops conversion like QADC_CMD_STOP_CONV. The instance must use QADC_CONVERT_SEQUENTIAL.
+ * Only available from XC. From C use the event API directly from the application's own event loop.
+ *
+ * \param c_adc         Channel for collecting results and controlling the QADC. May be null.
+ * \param p_adc         An array of ports used for conversion.
+ * \param adc_rheo_state The QADC state initialised by qadc_rheo_init().
+ */
+[[combinable]]
+void qadc_rheo_task_combinable(NULLABLE_RESOURCE(chanend, c_adc), port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
+
 void qadc_rheo_task(NULLABLE_RESOURCE(chanend, c_adc), port p_adc[], REFERENCE_PARAM(qadc_rheo_state_t, adc_rheo_state));
 #else
 DECLARE_JOB(qadc_rheo_task, (chanend_t, port_t*, qadc_rheo_state_t*));
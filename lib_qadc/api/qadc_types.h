@@ -0,0 +1,358 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Types shared by the xcore tasks and the portable QADC core. This header has no xcore
+// dependencies so that the core can also be built and benchmarked on a host.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef UNSAFE
+#ifdef __XC__
+#define UNSAFE unsafe
+#else
+#define UNSAFE
+#endif
+#endif
+
+
+/** 
+ * @brief   Fixed point type used internally by QADC.
+ */
+typedef uint16_t         qadc_q3_13_fixed_t;
+
+/** 
+ * @brief   The shift value needed to work with qadc_q3_13_fixed_t
+ */
+#define QADC_Q_3_13_SHIFT    13
+
+/** 
+ * @brief   Filter applied to each channel's conversion results before hysteresis.
+ */
+typedef enum qadc_filter_type_t{
+    /** Moving average (boxcar) over the last filter_depth results. Needs a history buffer per channel. */
+    QADC_FILTER_MOVING_AVERAGE = 0,
+    /** Single-pole IIR with a time constant of roughly filter_depth conversions (rounded down to a power of two).
+     *  Needs no history buffer. */
+    QADC_FILTER_IIR,
+    /** As QADC_FILTER_IIR but the time constant shortens as the input moves away from the output so that large
+     *  moves are tracked quickly while a stationary input is smoothed heavily. Needs no history buffer. */
+    QADC_FILTER_SLEW_ADAPTIVE
+}qadc_filter_type_t;
+
+/** 
+ * @brief   How qadc_pot_task() schedules conversions across channels.
+ */
+typedef enum qadc_conversion_mode_t{
+    /** Convert one channel per conversion slot, cycling through all channels. */
+    QADC_CONVERT_SEQUENTIAL = 0,
+    /** Convert several channels in the same conversion slot.
+     *  Potentiometer reader: every pin of a multi-bit port is converted together. Each pin is charged to the
+     *  opposite of its current level and the transition time of each pin is taken from the same stream of port
+     *  events. Every pin of the port is driven for the charge, as xcore ports have no per pin direction
+     *  control, so num_adc must be a multiple of the port width and no pin may be left spare. Has no effect
+     *  on 1-bit ports.
+     *  Rheostat reader: all ports are charged and released together and each port's discharge is timed
+     *  independently. The ports still to finish are tracked in one word so num_adc is limited to
+     *  QADC_MAX_PORT_WIDTH in this mode, which qadc_rheo_init() asserts. */
+    QADC_CONVERT_PARALLEL,
+    /** Convert one channel at a time but start the next charge as soon as the previous conversion has finished
+     *  and, for the potentiometer reader, the capacitor has settled for a time derived from the channel's
+     *  position, rather than waiting for a fixed worst case slot. Channels whose result has not changed for
+     *  QADC_ADAPTIVE_IDLE_CONVERSIONS conversions are only converted once per idle_interval_ticks until they
+     *  change again. convert_interval_ticks is not used. Up to QADC_ADAPTIVE_MAX_CH channels. */
+    QADC_CONVERT_ADAPTIVE,
+    /** Charge the next channel while the current one is converting, so the charge and conversion phases of
+     *  neighbouring channels overlap. convert_interval_ticks is the time between the start of each channel's
+     *  conversion and need only cover the longer of the charge and conversion phases rather than both.
+     *  Needs a separate port per channel, so 1-bit ports for the potentiometer reader, and at least two
+     *  channels. Otherwise channels are converted as QADC_CONVERT_SEQUENTIAL. */
+    QADC_CONVERT_PIPELINED
+}qadc_conversion_mode_t;
+
+#ifndef QADC_ADAPTIVE_MAX_CH
+/** 
+ * @brief   Most channels supported by QADC_CONVERT_ADAPTIVE. Each costs 8 bytes of task stack.
+ */
+#define QADC_ADAPTIVE_MAX_CH            32
+#endif
+
+#ifndef QADC_ADAPTIVE_IDLE_CONVERSIONS
+/** 
+ * @brief   Conversions with an unchanged result before a channel is treated as idle by QADC_CONVERT_ADAPTIVE.
+ */
+#define QADC_ADAPTIVE_IDLE_CONVERSIONS  16
+#endif
+
+/** 
+ * @brief   Scheduling state for QADC_CONVERT_ADAPTIVE. Held by the conversion task.
+ */
+typedef struct qadc_adaptive_sched_t{
+    size_t num_adc;
+    unsigned next_idx;
+    uint32_t idle_interval_ticks;
+    uint32_t next_due[QADC_ADAPTIVE_MAX_CH];
+    uint16_t unchanged_count[QADC_ADAPTIVE_MAX_CH];
+    uint16_t last_result[QADC_ADAPTIVE_MAX_CH];
+}qadc_adaptive_sched_t;
+
+/** 
+ * @brief   Widest port supported by QADC.
+ */
+#define QADC_MAX_PORT_WIDTH     32
+
+/** 
+ * @brief   Per-instance filter state. These should not be accessed directly and instead
+ *          be initialised by a call to qadc_xxx_init().
+ */
+typedef struct qadc_filter_t{
+    qadc_filter_type_t type;
+    size_t depth;
+    unsigned shift;
+    unsigned slew_shift;
+    uint32_t * UNSAFE accum;
+    uint16_t * UNSAFE history;
+    uint16_t * UNSAFE write_idx;
+}qadc_filter_t;
+
+/** 
+ * @brief   Number of uint16_t state entries needed by the filter for all channels, including
+ *          one entry of padding to word align the accumulators.
+ */
+#define QADC_FILTER_STATE_SIZE(num_adc, filter_type, filter_depth)                      ( \
+    /* accum */              (2 * (num_adc)) +                                            \
+    /* alignment pad */      1 +                                                          \
+    /* history */            ((filter_type) == QADC_FILTER_MOVING_AVERAGE ? (num_adc) * (filter_depth) : 0) + \
+    /* write_idx */          ((filter_type) == QADC_FILTER_MOVING_AVERAGE ? (num_adc) : 0))
+
+/** 
+ * @brief   Configuration structure for initialising the QADC. This contains
+ *          the passive component definition, voltages, conversion speed ( adc_xxx_task() only ) 
+ *          and mode.
+ */
+typedef struct qadc_config_t{
+    /** Capacitor size in picofarads. Should include the stray capacitance of the PCB. */
+    unsigned capacitor_pf;
+    /** Potentiometer value in ohms - nominal maximum value end to end. */
+    unsigned potentiometer_ohms;
+    /** Series resistor size in ohms. */
+    unsigned resistor_series_ohms;
+    /** Voltage of the IO rail used by the QADC port as a float. */
+    float v_rail;
+    /** Voltage of the input threshold. This is nominally 1.15 volts for a 3.3 volt rail. It may be measured
+     *  before initialisation using qadc_find_threshold(). */
+    float v_thresh;
+    /** Boolean setting which allows the largest time seen by the conversion to be trimmed if it
+     *  exceeds the expected value. The new end point will be kept until the task is re-started. 
+     *  It can account for cases where the RC delay constant is much larger than expected. 
+     *  Note no scheme is available for detecting the case where the RC constant is shorter 
+     *  than expected. */ 
+    char auto_scale;
+    /** The full conversion cycle time per channel (adc_xxx_task() only). The task will assert
+     *  at initialisation if this is too short. This setting is ignored in single-shot mode.*/    
+    unsigned convert_interval_ticks;
+    /** The filter applied to conversion results. The state buffer must be sized for the same filter
+     *  type using QADC_POT_STATE_SIZE_WITH_FILTER() or QADC_RHEO_STATE_SIZE_WITH_FILTER(). Defaults
+     *  to QADC_FILTER_MOVING_AVERAGE when left as zero. */
+    qadc_filter_type_t filter_type;
+    /** How channels are scheduled for conversion (adc_xxx_task() only). Defaults to QADC_CONVERT_SEQUENTIAL 
+     *  when left as zero. With QADC_CONVERT_PARALLEL convert_interval_ticks is the period per port (potentiometer)
+     *  or per scan of all channels (rheostat) rather than per channel. */
+    qadc_conversion_mode_t conversion_mode;
+    /** With QADC_CONVERT_ADAPTIVE, the conversion period of channels whose result is not changing. Zero
+     *  converts idle channels as often as active ones. Ignored in the other modes. */
+    uint32_t idle_interval_ticks;
+    /** Number of fractional bits in each result. Zero gives integer results. Otherwise results are fixed point
+     *  with this many bits below the binary point, interpolated between LUT entries (potentiometer) or quantised
+     *  more finely (rheostat), and the filter and hysteresis run at that precision. result_hysteresis is in
+     *  these finer units. Full scale, (lut_size - 1) or (adc_steps - 1) shifted up by this, must fit in 16 bits. */
+    unsigned result_frac_bits;
+    /** Boolean setting which defers filtering and hysteresis, and the potentiometer LUT lookup or the rheostat
+     *  scaling, to a single pass over all channels at the end of each scan (adc_xxx_task(), the event engine and
+     *  qadc_mixed_task()). Each conversion then only records its raw ticks (and direction), shortening the time
+     *  spent between conversions, and results
+     *  update once per scan rather than once per channel. Not supported with QADC_CONVERT_ADAPTIVE. Up to 32 channels. */
+    unsigned batch_post_process;
+}qadc_config_t;
+
+/** 
+ * @brief   Maximum number of monotonic runs per direction tracked by the LUT search index.
+ *          A LUT which needs more runs than this is searched linearly instead.
+ */
+#define QADC_POT_LUT_MAX_RUNS   8
+
+/** 
+ * @brief   A run of contiguous, non-zero and monotonic LUT entries (start and end inclusive).
+ */
+typedef struct qadc_pot_lut_run_t{
+    uint16_t start;
+    uint16_t end;
+    uint16_t is_rising;
+}qadc_pot_lut_run_t;
+
+/** 
+ * @brief   Search index built over the up and down LUTs at initialisation. This allows
+ *          ticks_to_position() to binary search each monotonic run rather than scan the whole table.
+ */
+typedef struct qadc_pot_lut_index_t{
+    unsigned num_up_runs;
+    unsigned num_down_runs;
+    qadc_pot_lut_run_t up_runs[QADC_POT_LUT_MAX_RUNS];
+    qadc_pot_lut_run_t down_runs[QADC_POT_LUT_MAX_RUNS];
+    unsigned use_linear_search;
+}qadc_pot_lut_index_t;
+
+/** 
+ * @brief   Potentiometer look up table descriptor. Only one direction is populated for each position so the up and
+ *          down conversion tables are held as a single compact table, split at split_idx, along with the values
+ *          derived from it. The table may live in the instance's state buffer, in a buffer shared between
+ *          instances (see qadc_pot_lut_init()) or in a const table generated offline by tools/qadc_pot_lut_gen.
+ */
+typedef struct qadc_pot_lut_t{
+    const uint16_t * UNSAFE ticks;  // Down transition times below split_idx, up transition times from split_idx
+    size_t lut_size;
+    unsigned split_idx;
+    uint32_t max_lut_ticks_up;
+    uint32_t max_lut_ticks_down;
+    unsigned crossover_idx;
+    qadc_pot_lut_index_t index;
+}qadc_pot_lut_t;
+
+/** 
+ * @brief   Macro for sizing the buffer passed to qadc_pot_lut_init(), in uint16_t entries.
+ */
+#define QADC_POT_LUT_BUFFER_SIZE(lut_size)      (lut_size)
+
+/** 
+ * @brief   Macro for sizing the buffer passed to qadc_pot_attach_cal_buffer(), in uint16_t entries. Holds the
+ *          table in use and the one being built so a recalibrated table can be swapped in without a glitch.
+ */
+#define QADC_POT_CAL_BUFFER_SIZE(lut_size)      (2 * (lut_size))
+
+#ifndef QADC_POT_CAL_CHUNK
+/** @brief LUT entries rebuilt per scan after QADC_CMD_CAL_MODE_FINISH. Bounds the time taken from each scan. */
+#define QADC_POT_CAL_CHUNK      32
+#endif
+
+/** 
+ * @brief   Potentiometer recalibration state. The LUT made at initialisation is kept as a reference and each
+ *          recalibration rescales it, in fixed point and a chunk per scan, into whichever half of the
+ *          calibration buffer is not in use before swapping the descriptors. These should not be accessed directly.
+ */
+typedef struct qadc_pot_cal_t{
+    uint16_t * UNSAFE buffer;               // QADC_POT_CAL_BUFFER_SIZE() entries, NULL if none attached
+    const uint16_t * UNSAFE ref_ticks;      // The LUT made at initialisation
+    uint32_t ref_max_lut_ticks_up;
+    uint32_t ref_max_lut_ticks_down;
+    unsigned observing;                     // Set between QADC_CMD_CAL_MODE_START and QADC_CMD_CAL_MODE_FINISH
+    unsigned rebuild_idx;                   // Next entry of the shadow table to build, lut_size when not building
+    unsigned next_half;                     // Half of buffer the next table is built in
+    uint32_t scale_up;                      // Q16 ratio of the observed to the reference maximum, per direction
+    uint32_t scale_down;
+    qadc_pot_lut_t shadow;                  // Descriptor of the table being built
+}qadc_pot_cal_t;
+
+#ifndef QADC_MAILBOX_MAX_CH
+/** @brief Channels held by a qadc_mailbox_t. May be overridden up to 32 for the whole application. */
+#define QADC_MAILBOX_MAX_CH     8
+#endif
+
+/** 
+ * @brief   Shared memory result mailbox for same tile clients. The QADC task publishes a complete scan of
+ *          all channels at a time under a sequence counter so readers never see a partially updated scan.
+ *          Read using qadc_mailbox_read() only.
+ */
+typedef struct qadc_mailbox_t{
+    uint32_t seq;                                   // Odd while the task is publishing, advances by two per scan
+    size_t num_adc;
+    uint16_t results[QADC_MAILBOX_MAX_CH];
+    uint32_t timestamps[QADC_MAILBOX_MAX_CH];       // Reference timer value when each result was converted
+    uint32_t change_seq[QADC_MAILBOX_MAX_CH];       // seq of the scan in which each result last changed
+    uint32_t pending_timestamps[QADC_MAILBOX_MAX_CH]; // Task private. Timestamps for the scan in progress
+}qadc_mailbox_t;
+
+/** 
+ * @brief   A consistent copy of the mailbox taken by qadc_mailbox_read(). Zero initialise before the first read.
+ */
+typedef struct qadc_mailbox_snapshot_t{
+    uint32_t seq;                                   // Sequence number of the scan copied. Zero before the first read
+    uint32_t new_data_mask;                         // Channels whose result changed since the previous read
+    size_t num_adc;
+    uint16_t results[QADC_MAILBOX_MAX_CH];
+    uint32_t timestamps[QADC_MAILBOX_MAX_CH];       // Reference timer (100 MHz) value when each result was converted
+}qadc_mailbox_snapshot_t;
+
+#ifndef QADC_STATS_MAX_CH
+/** 
+ * @brief   Most channels with their own counters in a qadc_stats_t. Further channels count towards the
+ *          instance totals only.
+ */
+#define QADC_STATS_MAX_CH       8
+#endif
+
+/** 
+ * @brief   Number of bins in each conversion time histogram of a qadc_stats_t.
+ */
+#define QADC_STATS_HIST_BINS    16
+
+/** 
+ * @brief   Runtime statistics for one QADC instance, attached with qadc_pot_attach_stats() or
+ *          qadc_rheo_attach_stats(). Index [1] of each direction pair is for potentiometer conversions
+ *          from low to high, index [0] for high to low and for all rheostat conversions. Times are in
+ *          100 MHz ticks.
+ */
+typedef struct qadc_stats_t{
+    uint32_t num_adc;
+    uint32_t hist_full_scale;                       // Bin i counts times from i to i + 1 times full scale / QADC_STATS_HIST_BINS
+    uint32_t conversions[QADC_STATS_MAX_CH];        // Conversions which crossed the threshold
+    uint32_t soft_overshoots[QADC_STATS_MAX_CH];    // Longer than the LUT expected (potentiometer only)
+    uint32_t hard_overshoots[QADC_STATS_MAX_CH];    // Never crossed the threshold
+    uint16_t min_ticks[QADC_STATS_MAX_CH][2];       // Shortest conversion time per direction
+    uint16_t max_ticks[QADC_STATS_MAX_CH][2];       // Longest conversion time per direction
+    uint32_t histogram[2][QADC_STATS_HIST_BINS];    // Conversion times of all channels per direction
+    uint32_t missed_periods;                        // Conversions which finished after the next charge was due
+    uint32_t max_proc_ticks;                        // Longest post processing time of a result
+    int32_t min_slack_ticks;                        // Least time between a conversion ending and the next charge
+}qadc_stats_t;
+
+/** 
+ * @brief   Progress of a split-phase single shot conversion started by qadc_pot_single_start() or
+ *          qadc_rheo_single_start().
+ */
+typedef enum qadc_single_phase_t{
+    QADC_SINGLE_IDLE = 0,
+    QADC_SINGLE_CHARGING,
+    QADC_SINGLE_CONVERTING,
+    QADC_SINGLE_DONE
+}qadc_single_phase_t;
+
+/** 
+ * @brief   State of a split-phase single shot conversion, held in the QADC instance state. These should not
+ *          be accessed directly.
+ */
+typedef struct qadc_single_state_t{
+    qadc_single_phase_t phase;
+    unsigned adc_idx;
+    int32_t time_trigger_start_convert;
+    int32_t time_trigger_overshoot;
+    int32_t max_ticks_expected;
+    int32_t time_settled;           // Earliest time for the next charge
+    uint32_t settle_ticks;
+    unsigned post_charge_port_val;
+    unsigned pin_event_value;
+    int16_t start_time;
+}qadc_single_state_t;
+
+/** 
+ * @brief   State of the event driven conversion engine used by qadc_pot_task_combinable(),
+ *          qadc_rheo_task_combinable() and the event API, held in the QADC instance state. These should not
+ *          be accessed directly.
+ */
+typedef struct qadc_event_state_t{
+    unsigned running;
+    unsigned adc_idx;               // Channel converted in the next slot
+    unsigned calibrating;           // Rheostat only, set between the calibration commands
+    int32_t time_trigger_charge;    // Start of the next slot
+}qadc_event_state_t;
@@ -0,0 +1,71 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdint.h>
+#include <assert.h>
+#include "qadc_core.h"
+
+// Time constants allowed for the capacitor to approach the wiper voltage after crossing the threshold. Three
+// leaves it within 5% of the remaining distance, which is enough to read the right side of the threshold.
+#define QADC_POT_SETTLE_RC_TIMES    3
+
+
+uint32_t qadc_pot_settle_ticks(uint32_t rc_ticks, unsigned position, size_t lut_size){
+    if(lut_size < 2 || position >= lut_size - 1){
+        return 0;
+    }
+    // The capacitor sees the two halves of the track in parallel, R * x * (1 - x)
+    const uint64_t full_scale = lut_size - 1;
+    uint64_t ticks = (uint64_t)QADC_POT_SETTLE_RC_TIMES * rc_ticks * position * (full_scale - position);
+    return (uint32_t)(ticks / (full_scale * full_scale));
+}
+
+
+void qadc_adaptive_init(qadc_adaptive_sched_t *sched, size_t num_adc, uint32_t idle_interval_ticks, uint32_t time_now){
+    assert(num_adc <= QADC_ADAPTIVE_MAX_CH);
+    sched->num_adc = num_adc;
+    sched->next_idx = 0;
+    sched->idle_interval_ticks = idle_interval_ticks;
+    for(unsigned i = 0; i < num_adc; i++){
+        sched->next_due[i] = time_now;
+        sched->unchanged_count[i] = 0;
+        sched->last_result[i] = 0;
+    }
+}
+
+
+void qadc_adaptive_result(qadc_adaptive_sched_t *sched, unsigned adc_idx, uint16_t result, uint32_t time_now){
+    if(result != sched->last_result[adc_idx]){
+        sched->unchanged_count[adc_idx] = 0;
+        sched->last_result[adc_idx] = result;
+    } else if(sched->unchanged_count[adc_idx] < QADC_ADAPTIVE_IDLE_CONVERSIONS){
+        sched->unchanged_count[adc_idx]++;
+    }
+
+    int is_idle = sched->unchanged_count[adc_idx] == QADC_ADAPTIVE_IDLE_CONVERSIONS;
+    sched->next_due[adc_idx] = time_now + (is_idle ? sched->idle_interval_ticks : 0);
+    sched->next_idx = adc_idx + 1 == sched->num_adc ? 0 : adc_idx + 1;
+}
+
+
+unsigned qadc_adaptive_next(qadc_adaptive_sched_t *sched, uint32_t earliest, uint32_t *start_time){
+    unsigned soonest_idx = sched->next_idx;
+    int32_t soonest_wait = INT32_MAX;
+
+    unsigned idx = sched->next_idx;
+    for(unsigned i = 0; i < sched->num_adc; i++){
+        int32_t wait = (int32_t)(sched->next_due[idx] - earliest); // Wrap safe
+        if(wait <= 0){
+            *start_time = earliest;
+            return idx;
+        }
+        if(wait < soonest_wait){
+            soonest_wait = wait;
+            soonest_idx = idx;
+        }
+        idx = idx + 1 == sched->num_adc ? 0 : idx + 1;
+    }
+
+    *start_time = sched->next_due[soonest_idx];
+    return soonest_idx;
+}
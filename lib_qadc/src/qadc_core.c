@@ -0,0 +1,175 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <math.h>
+#include <stdint.h>
+#include "qadc_core.h"
+
+
+uint16_t qadc_hysteresis(uint16_t result, uint16_t *tracker, unsigned hysteresis, unsigned full_scale){
+    if(result > *tracker + hysteresis || result == full_scale){
+        *tracker = result;
+    }
+    if(result < *tracker - hysteresis || result == 0){
+        *tracker = result;
+    }
+
+    return *tracker;
+}
+
+
+void qadc_hysteresis_batch(uint16_t *results, uint16_t *tracker, unsigned hysteresis, unsigned full_scale, size_t num_adc){
+    // The tests of qadc_hysteresis() folded into one select per channel so the loop has no branches
+    for(size_t i = 0; i < num_adc; i++){
+        const unsigned result = results[i];
+        const unsigned held = tracker[i];
+        const int move = (result > held + hysteresis) | (result == full_scale) | (result < held - hysteresis) | (result == 0);
+        tracker[i] = move ? result : held;
+        results[i] = tracker[i];
+    }
+}
+
+
+int32_t qadc_pot_max_ticks_expected(uint32_t max_lut_ticks, qadc_q3_13_fixed_t max_scale){
+    return (max_lut_ticks * (uint32_t)max_scale) >> QADC_Q_3_13_SHIFT;
+}
+
+
+qadc_q3_13_fixed_t qadc_pot_auto_scale(qadc_q3_13_fixed_t max_scale, int32_t conversion_time, int32_t max_ticks_expected){
+    return ((uint32_t)max_scale * (uint32_t)conversion_time) / (uint32_t)max_ticks_expected;
+}
+
+
+uint32_t qadc_pot_ticks_to_position(const qadc_pot_lut_t *lut, int is_up, uint16_t ticks, qadc_q3_13_fixed_t max_scale, unsigned frac_bits){
+    //Apply scaling (for best adjusting crossover smoothness)
+    ticks = (uint32_t)ticks << QADC_Q_3_13_SHIFT / max_scale;
+
+    // Binary search the monotonic runs of the LUT rather than scanning the whole table
+    unsigned idx = qadc_pot_lut_search_compact(&lut->index, lut->ticks, lut->split_idx, lut->lut_size, is_up, ticks);
+    if(frac_bits == 0){
+        return idx;
+    }
+    return qadc_pot_lut_interpolate(lut->ticks, lut->split_idx, lut->lut_size, is_up, ticks, idx, frac_bits);
+}
+
+
+void qadc_pot_ticks_to_position_batch(const qadc_pot_lut_t *lut, uint16_t *values, uint32_t convert_mask, uint32_t up_mask,
+                                      const qadc_q3_13_fixed_t *max_scale_up, const qadc_q3_13_fixed_t *max_scale_down,
+                                      unsigned frac_bits, size_t num_adc){
+    num_adc = QADC_NUM_ADC(num_adc);
+    for(unsigned i = 0; i < num_adc; i++){
+        if((convert_mask >> i) & 0x1){
+            const int is_up = (up_mask >> i) & 0x1;
+            const qadc_q3_13_fixed_t max_scale = is_up ? max_scale_up[i] : max_scale_down[i];
+            values[i] = qadc_pot_ticks_to_position(lut, is_up, values[i], max_scale, frac_bits);
+        }
+    }
+}
+
+
+uint16_t qadc_pot_post_process(qadc_filter_t *filter, uint16_t *hysteris_tracker, unsigned adc_idx,
+                               unsigned result_hysteresis, size_t lut_size, unsigned frac_bits, uint16_t raw_result){
+    uint16_t filtered_result = qadc_filter_apply(filter, adc_idx, raw_result);
+
+    return qadc_hysteresis(filtered_result, &hysteris_tracker[adc_idx], result_hysteresis, (QADC_LUT_SIZE(lut_size) - 1) << frac_bits);
+}
+
+
+void qadc_pot_post_process_batch(qadc_filter_t *filter, uint16_t *hysteris_tracker, const uint16_t *raw_results, uint16_t *results,
+                                 size_t num_adc, unsigned result_hysteresis, size_t lut_size, unsigned frac_bits){
+    num_adc = QADC_NUM_ADC(num_adc);
+    qadc_filter_apply_batch(filter, raw_results, results, num_adc);
+
+    qadc_hysteresis_batch(results, hysteris_tracker, result_hysteresis, (QADC_LUT_SIZE(lut_size) - 1) << frac_bits, num_adc);
+}
+
+
+unsigned qadc_rheo_calc_max_disch_ticks(float r_rheo_max, float capacitor_f, float rs_ohms, float v_rail, float v_thresh){
+    // Calculate actual charge voltage of capacitor
+    const float v_charge_h = r_rheo_max / (r_rheo_max + rs_ohms) * v_rail;
+
+    // Calc the maximum discharge time to threshold
+    const float v_down_offset = v_rail - v_charge_h;
+    const float t_down = (-r_rheo_max) * capacitor_f * log(1 - (v_rail - v_thresh - v_down_offset) / (v_rail - 0.0 - v_down_offset));
+    dprintf("v_charge_h: %f t_down: %f\n", v_charge_h, t_down);
+
+    return (unsigned)(t_down * XS1_TIMER_HZ);
+}
+
+
+uint16_t qadc_rheo_post_process(qadc_filter_t *filter, uint16_t *hysteris_tracker, uint16_t *max_seen_ticks,
+                                qadc_q3_13_fixed_t *max_scale, unsigned adc_idx, int auto_scale,
+                                unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks, uint16_t raw_result){
+    max_disch_ticks = QADC_MAX_DISCH_TICKS(max_disch_ticks);
+
+    // Apply filter
+    uint16_t filtered_elapsed_time = qadc_filter_apply(filter, adc_idx, raw_result);
+
+    // Track maximums
+    if(filtered_elapsed_time > max_seen_ticks[adc_idx]){
+        dprintf("max_seen: %u\n", max_seen_ticks[adc_idx]);
+        max_seen_ticks[adc_idx] = filtered_elapsed_time;
+
+        // Scale here if using calib
+        if(auto_scale){
+            max_scale[adc_idx] = (max_disch_ticks << QADC_Q_3_13_SHIFT) / max_seen_ticks[adc_idx];
+            dprintf("stretch scale\n");
+        }
+    }
+
+    // Scale down - max_scale grows if number of expected ticks higher. max_scale is only adjusted if auto_scale is set
+    uint16_t scaled_time = ((int32_t)max_scale[adc_idx] * (int32_t)filtered_elapsed_time) >> QADC_Q_3_13_SHIFT;
+
+    // Clip positive
+    if(scaled_time > max_disch_ticks){
+        scaled_time = max_disch_ticks;
+    }
+
+    // Calculate scaled output. The filter already ran on raw ticks so fractional bits are just a finer quantisation.
+    const uint32_t full_scale = (uint32_t)(QADC_ADC_STEPS(adc_steps) - 1) << frac_bits;
+    uint16_t scaled_result = (full_scale * scaled_time) / max_disch_ticks;
+
+    return qadc_hysteresis(scaled_result, &hysteris_tracker[adc_idx], result_hysteresis, full_scale);
+}
+
+
+void qadc_rheo_post_process_batch(qadc_filter_t *filter, uint16_t *hysteris_tracker, uint16_t *max_seen_ticks,
+                                  qadc_q3_13_fixed_t *max_scale, int auto_scale,
+                                  unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks,
+                                  const uint16_t *raw_results, uint16_t *results, size_t num_adc){
+    num_adc = QADC_NUM_ADC(num_adc);
+    max_disch_ticks = QADC_MAX_DISCH_TICKS(max_disch_ticks);
+
+    // Filter every channel's ticks first, then the same steps as qadc_rheo_post_process() one stage at a time
+    qadc_filter_apply_batch(filter, raw_results, results, num_adc);
+
+    if(auto_scale){
+        for(unsigned i = 0; i < num_adc; i++){
+            if(results[i] > max_seen_ticks[i]){
+                max_seen_ticks[i] = results[i];
+                max_scale[i] = (max_disch_ticks << QADC_Q_3_13_SHIFT) / max_seen_ticks[i];
+            }
+        }
+    } else {
+        for(unsigned i = 0; i < num_adc; i++){
+            max_seen_ticks[i] = results[i] > max_seen_ticks[i] ? results[i] : max_seen_ticks[i];
+        }
+    }
+
+    const uint32_t full_scale = (uint32_t)(QADC_ADC_STEPS(adc_steps) - 1) << frac_bits;
+    for(unsigned i = 0; i < num_adc; i++){
+        uint16_t scaled_time = ((int32_t)max_scale[i] * (int32_t)results[i]) >> QADC_Q_3_13_SHIFT;
+        scaled_time = scaled_time > max_disch_ticks ? max_disch_ticks : scaled_time;
+        results[i] = (full_scale * scaled_time) / max_disch_ticks;
+    }
+    qadc_hysteresis_batch(results, hysteris_tracker, result_hysteresis, full_scale, num_adc);
+}
+
+
+qadc_q3_13_fixed_t qadc_rheo_cal_scale(uint16_t max_disch_ticks, uint16_t max_seen_ticks){
+    if(max_seen_ticks == 0){
+        return 1 << QADC_Q_3_13_SHIFT; // Nothing seen so leave the channel unscaled
+    }
+    uint32_t scale = ((uint32_t)max_disch_ticks << QADC_Q_3_13_SHIFT) / max_seen_ticks;
+    return scale > UINT16_MAX ? UINT16_MAX : (qadc_q3_13_fixed_t)scale;
+}
@@ -0,0 +1,203 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Portable conversion maths used by the QADC tasks. Everything declared here is plain C with no
+// xcore dependencies so it can also be built and benchmarked on a host (see tests/qadc_host_core).
+
+#ifndef __QADC_CORE__
+#define __QADC_CORE__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "qadc_types.h"
+#include "qadc_static.h"
+
+// #define dprintf(...) printf(__VA_ARGS__)
+#define dprintf(...)
+
+#define QADC_POT_CAL_SCALE_SHIFT    16 // Fixed point shift of the LUT recalibration scale factors
+
+#if defined(__XS1B__) || defined(__XS2A__) || defined(__XS3A__)
+#include <platform.h>
+#else
+#define XS1_TIMER_HZ    100000000 // Reference clock on xcore, used for LUT generation on the host
+#endif
+
+// Orders memory accesses between the QADC task and a same tile reader. Threads on one tile share memory
+// coherently so only the compiler needs restraining there. Hosts need a real fence.
+#if defined(__XS1B__) || defined(__XS2A__) || defined(__XS3A__)
+#define QADC_MEMORY_BARRIER()   __asm__ __volatile__("" ::: "memory")
+#else
+#define QADC_MEMORY_BARRIER()   __sync_synchronize()
+#endif
+
+#ifdef __XC__
+void gen_lookup_pot(uint16_t * unsafe up, uint16_t * unsafe down, unsigned num_points,
+                    float r_ohms, float capacitor_f, float rs_ohms,
+                    float v_rail, float v_thresh,
+                    uint32_t * unsafe max_lut_ticks_up, uint32_t * unsafe max_lut_ticks_down);
+void gen_lookup_pot_compact(uint16_t * unsafe ticks, unsigned num_points,
+                            float r_ohms, float capacitor_f, float rs_ohms,
+                            float v_rail, float v_thresh, unsigned * unsafe split_idx,
+                            uint32_t * unsafe max_lut_ticks_up, uint32_t * unsafe max_lut_ticks_down);
+void qadc_pot_lut_gen(qadc_pot_lut_t &lut, uint16_t * unsafe buffer, size_t lut_size,
+                      float r_ohms, float capacitor_f, float rs_ohms, float v_rail, float v_thresh);
+void qadc_pot_lut_index_build(qadc_pot_lut_index_t &index, const uint16_t * unsafe up, const uint16_t * unsafe down, unsigned num_points);
+unsigned qadc_pot_lut_search(qadc_pot_lut_index_t &index, const uint16_t * unsafe up, const uint16_t * unsafe down, unsigned num_points, int is_up, uint16_t ticks);
+unsigned qadc_pot_lut_search_linear(const uint16_t * unsafe up, const uint16_t * unsafe down, unsigned num_points, int is_up, uint16_t ticks);
+void qadc_pot_lut_index_build_compact(qadc_pot_lut_index_t &index, const uint16_t * unsafe ticks, unsigned split_idx, unsigned num_points);
+unsigned qadc_pot_lut_search_compact(qadc_pot_lut_index_t &index, const uint16_t * unsafe ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks);
+unsigned qadc_pot_lut_search_compact_linear(const uint16_t * unsafe ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks);
+uint32_t qadc_pot_lut_interpolate(const uint16_t * unsafe ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks, unsigned idx, unsigned frac_bits);
+uint32_t qadc_pot_lut_cal_scale(uint32_t observed_max, uint32_t ref_max);
+uint16_t qadc_pot_lut_rescale_ticks(uint32_t ticks, uint32_t scale);
+void qadc_pot_lut_rescale(uint16_t * unsafe dst, const uint16_t * unsafe ref, unsigned start, unsigned end, unsigned split_idx,
+                          uint32_t scale_down, uint32_t scale_up);
+uint16_t * unsafe qadc_filter_init(qadc_filter_t &filter, qadc_filter_type_t type, size_t depth, unsigned full_scale, size_t num_adc, uint16_t * unsafe buffer);
+void qadc_filter_reset(qadc_filter_t &filter, size_t num_adc);
+uint16_t qadc_filter_apply(qadc_filter_t &filter, unsigned adc_idx, uint16_t raw_result);
+void qadc_filter_apply_batch(qadc_filter_t &filter, const uint16_t * unsafe raw_results, uint16_t * unsafe filtered, size_t num_adc);
+uint16_t qadc_hysteresis(uint16_t result, uint16_t * unsafe tracker, unsigned hysteresis, unsigned full_scale);
+void qadc_hysteresis_batch(uint16_t * unsafe results, uint16_t * unsafe tracker, unsigned hysteresis, unsigned full_scale, size_t num_adc);
+int32_t qadc_pot_max_ticks_expected(uint32_t max_lut_ticks, qadc_q3_13_fixed_t max_scale);
+qadc_q3_13_fixed_t qadc_pot_auto_scale(qadc_q3_13_fixed_t max_scale, int32_t conversion_time, int32_t max_ticks_expected);
+uint32_t qadc_pot_ticks_to_position(const qadc_pot_lut_t &lut, int is_up, uint16_t ticks, qadc_q3_13_fixed_t max_scale, unsigned frac_bits);
+void qadc_pot_ticks_to_position_batch(const qadc_pot_lut_t &lut, uint16_t * unsafe values, uint32_t convert_mask, uint32_t up_mask,
+                                      const qadc_q3_13_fixed_t * unsafe max_scale_up, const qadc_q3_13_fixed_t * unsafe max_scale_down,
+                                      unsigned frac_bits, size_t num_adc);
+uint16_t qadc_pot_post_process(qadc_filter_t &filter, uint16_t * unsafe hysteris_tracker, unsigned adc_idx,
+                               unsigned result_hysteresis, size_t lut_size, unsigned frac_bits, uint16_t raw_result);
+void qadc_pot_post_process_batch(qadc_filter_t &filter, uint16_t * unsafe hysteris_tracker, const uint16_t * unsafe raw_results, uint16_t * unsafe results,
+                                 size_t num_adc, unsigned result_hysteresis, size_t lut_size, unsigned frac_bits);
+unsigned qadc_rheo_calc_max_disch_ticks(float r_rheo_max, float capacitor_f, float rs_ohms, float v_rail, float v_thresh);
+uint16_t qadc_rheo_post_process(qadc_filter_t &filter, uint16_t * unsafe hysteris_tracker, uint16_t * unsafe max_seen_ticks,
+                                qadc_q3_13_fixed_t * unsafe max_scale, unsigned adc_idx, int auto_scale,
+                                unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks, uint16_t raw_result);
+void qadc_rheo_post_process_batch(qadc_filter_t &filter, uint16_t * unsafe hysteris_tracker, uint16_t * unsafe max_seen_ticks,
+                                  qadc_q3_13_fixed_t * unsafe max_scale, int auto_scale,
+                                  unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks,
+                                  const uint16_t * unsafe raw_results, uint16_t * unsafe results, size_t num_adc);
+qadc_q3_13_fixed_t qadc_rheo_cal_scale(uint16_t max_disch_ticks, uint16_t max_seen_ticks);
+void qadc_mailbox_init(qadc_mailbox_t * unsafe mailbox, size_t num_adc);
+void qadc_mailbox_stamp(qadc_mailbox_t * unsafe mailbox, unsigned adc_idx, uint32_t timestamp);
+void qadc_mailbox_publish(qadc_mailbox_t * unsafe mailbox, const uint16_t * unsafe results);
+void qadc_stats_init(qadc_stats_t * unsafe stats, size_t num_adc, uint32_t hist_full_scale);
+void qadc_stats_conversion(qadc_stats_t * unsafe stats, unsigned adc_idx, int is_up, uint32_t ticks);
+void qadc_stats_overshoot(qadc_stats_t * unsafe stats, unsigned adc_idx, int is_hard);
+void qadc_stats_proc_time(qadc_stats_t * unsafe stats, uint32_t ticks);
+void qadc_stats_slack(qadc_stats_t * unsafe stats, int32_t slack_ticks);
+uint32_t qadc_pot_settle_ticks(uint32_t rc_ticks, unsigned position, size_t lut_size);
+void qadc_adaptive_init(qadc_adaptive_sched_t &sched, size_t num_adc, uint32_t idle_interval_ticks, uint32_t time_now);
+void qadc_adaptive_result(qadc_adaptive_sched_t &sched, unsigned adc_idx, uint16_t result, uint32_t time_now);
+unsigned qadc_adaptive_next(qadc_adaptive_sched_t &sched, uint32_t earliest, uint32_t &start_time);
+#else
+void gen_lookup_pot(uint16_t * up, uint16_t * down, unsigned num_points,
+                    float r_ohms, float capacitor_f, float rs_ohms,
+                    float v_rail, float v_thresh,
+                    uint32_t *max_lut_ticks_up, uint32_t *max_lut_ticks_down);
+// Generate a compact LUT. One table holds the down transition times below split_idx and the up times from
+// split_idx upwards. Equivalent to the up and down tables from gen_lookup_pot() with the zeros removed.
+void gen_lookup_pot_compact(uint16_t * ticks, unsigned num_points,
+                            float r_ohms, float capacitor_f, float rs_ohms,
+                            float v_rail, float v_thresh, unsigned *split_idx,
+                            uint32_t *max_lut_ticks_up, uint32_t *max_lut_ticks_down);
+// Generate the compact table into buffer (lut_size entries) and fill in the rest of the descriptor.
+void qadc_pot_lut_gen(qadc_pot_lut_t *lut, uint16_t *buffer, size_t lut_size,
+                      float r_ohms, float capacitor_f, float rs_ohms, float v_rail, float v_thresh);
+// Build the monotonic run index used by qadc_pot_lut_search(). Call whenever the LUT contents change.
+void qadc_pot_lut_index_build(qadc_pot_lut_index_t *index, const uint16_t * up, const uint16_t * down, unsigned num_points);
+// Convert ticks to LUT index. Gives identical results to qadc_pot_lut_search_linear() in O(log n).
+unsigned qadc_pot_lut_search(const qadc_pot_lut_index_t *index, const uint16_t * up, const uint16_t * down, unsigned num_points, int is_up, uint16_t ticks);
+// Reference O(n) scan of the whole LUT.
+unsigned qadc_pot_lut_search_linear(const uint16_t * up, const uint16_t * down, unsigned num_points, int is_up, uint16_t ticks);
+// Compact table equivalents of the above. Results are identical to the full up and down tables.
+void qadc_pot_lut_index_build_compact(qadc_pot_lut_index_t *index, const uint16_t * ticks, unsigned split_idx, unsigned num_points);
+unsigned qadc_pot_lut_search_compact(const qadc_pot_lut_index_t *index, const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks);
+unsigned qadc_pot_lut_search_compact_linear(const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks);
+// Refine the index idx found by a compact search into a position with frac_bits fractional bits by interpolating
+// between it and the neighbouring entry on the other side of ticks.
+uint32_t qadc_pot_lut_interpolate(const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks, unsigned idx, unsigned frac_bits);
+// Scale factor, shifted by QADC_POT_CAL_SCALE_SHIFT, which maps a reference LUT maximum onto an observed one.
+// Unity if nothing was observed.
+uint32_t qadc_pot_lut_cal_scale(uint32_t observed_max, uint32_t ref_max);
+// Apply a scale factor to one LUT entry, saturating, and never turning a reachable entry into zero.
+uint16_t qadc_pot_lut_rescale_ticks(uint32_t ticks, uint32_t scale);
+// Rescale entries [start, end) of a compact reference table into dst. Entries below split_idx use scale_down.
+// Called a chunk at a time so a live task can rebuild its table between conversions.
+void qadc_pot_lut_rescale(uint16_t *dst, const uint16_t *ref, unsigned start, unsigned end, unsigned split_idx,
+                          uint32_t scale_down, uint32_t scale_up);
+// Carve the filter state for num_adc channels out of buffer and clear it. Returns a pointer to just after
+// the QADC_FILTER_STATE_SIZE() entries used. full_scale is the largest expected input value.
+uint16_t *qadc_filter_init(qadc_filter_t *filter, qadc_filter_type_t type, size_t depth, unsigned full_scale, size_t num_adc, uint16_t *buffer);
+// Clear filter history and accumulators for all channels.
+void qadc_filter_reset(qadc_filter_t *filter, size_t num_adc);
+// Push a new raw result into the channel's filter and return the filtered value. Constant time for all filter types.
+uint16_t qadc_filter_apply(qadc_filter_t *filter, unsigned adc_idx, uint16_t raw_result);
+// Push one new raw result per channel, for channels 0 to num_adc - 1, into the filter in a single pass. Identical
+// to calling qadc_filter_apply() for each channel in turn. filtered may be the same array as raw_results.
+void qadc_filter_apply_batch(qadc_filter_t *filter, const uint16_t *raw_results, uint16_t *filtered, size_t num_adc);
+// Apply hysteresis to one channel's result using that channel's tracker entry. The end stops always pass through.
+uint16_t qadc_hysteresis(uint16_t result, uint16_t *tracker, unsigned hysteresis, unsigned full_scale);
+// qadc_hysteresis() for channels 0 to num_adc - 1 at once, updating results in place.
+void qadc_hysteresis_batch(uint16_t *results, uint16_t *tracker, unsigned hysteresis, unsigned full_scale, size_t num_adc);
+// Longest conversion expected for a LUT maximum once scaled by the channel's auto_scale factor.
+int32_t qadc_pot_max_ticks_expected(uint32_t max_lut_ticks, qadc_q3_13_fixed_t max_scale);
+// Stretch a channel's scale factor so a conversion longer than expected becomes the new end point.
+qadc_q3_13_fixed_t qadc_pot_auto_scale(qadc_q3_13_fixed_t max_scale, int32_t conversion_time, int32_t max_ticks_expected);
+// Scale the measured ticks and convert them to a LUT index (unfiltered position) with frac_bits fractional bits.
+uint32_t qadc_pot_ticks_to_position(const qadc_pot_lut_t *lut, int is_up, uint16_t ticks, qadc_q3_13_fixed_t max_scale, unsigned frac_bits);
+// qadc_pot_ticks_to_position() in place for each channel set in convert_mask, up to 32 channels, taking the
+// direction from up_mask and the matching scale factor. Channels not in convert_mask are left alone.
+void qadc_pot_ticks_to_position_batch(const qadc_pot_lut_t *lut, uint16_t *values, uint32_t convert_mask, uint32_t up_mask,
+                                      const qadc_q3_13_fixed_t *max_scale_up, const qadc_q3_13_fixed_t *max_scale_down,
+                                      unsigned frac_bits, size_t num_adc);
+// Filter and hysteresis for one pot channel. Full scale is (lut_size - 1) << frac_bits.
+uint16_t qadc_pot_post_process(qadc_filter_t *filter, uint16_t *hysteris_tracker, unsigned adc_idx,
+                               unsigned result_hysteresis, size_t lut_size, unsigned frac_bits, uint16_t raw_result);
+// qadc_pot_post_process() for a whole scan of unfiltered positions at once, one processing stage at a time.
+void qadc_pot_post_process_batch(qadc_filter_t *filter, uint16_t *hysteris_tracker, const uint16_t *raw_results, uint16_t *results,
+                                 size_t num_adc, unsigned result_hysteresis, size_t lut_size, unsigned frac_bits);
+// Discharge time from a fully charged capacitor to the threshold with the rheostat at maximum.
+unsigned qadc_rheo_calc_max_disch_ticks(float r_rheo_max, float capacitor_f, float rs_ohms, float v_rail, float v_thresh);
+// Filter, auto_scale tracking, quantisation to adc_steps with frac_bits fractional bits and hysteresis for one rheo channel.
+uint16_t qadc_rheo_post_process(qadc_filter_t *filter, uint16_t *hysteris_tracker, uint16_t *max_seen_ticks,
+                                qadc_q3_13_fixed_t *max_scale, unsigned adc_idx, int auto_scale,
+                                unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks, uint16_t raw_result);
+// qadc_rheo_post_process() for a whole scan of discharge times at once, one processing stage at a time.
+void qadc_rheo_post_process_batch(qadc_filter_t *filter, uint16_t *hysteris_tracker, uint16_t *max_seen_ticks,
+                                  qadc_q3_13_fixed_t *max_scale, int auto_scale,
+                                  unsigned result_hysteresis, size_t adc_steps, unsigned frac_bits, uint16_t max_disch_ticks,
+                                  const uint16_t *raw_results, uint16_t *results, size_t num_adc);
+// Scale which maps the longest discharge seen during calibration onto full scale. Saturates in Q3.13.
+qadc_q3_13_fixed_t qadc_rheo_cal_scale(uint16_t max_disch_ticks, uint16_t max_seen_ticks);
+// Clear the mailbox for num_adc channels.
+void qadc_mailbox_init(qadc_mailbox_t *mailbox, size_t num_adc);
+// Record when a channel was converted. Held back until the scan is published.
+void qadc_mailbox_stamp(qadc_mailbox_t *mailbox, unsigned adc_idx, uint32_t timestamp);
+// Publish a complete scan of results to readers.
+void qadc_mailbox_publish(qadc_mailbox_t *mailbox, const uint16_t *results);
+// Take a consistent copy of the latest scan. See qadc.h.
+int qadc_mailbox_read(const qadc_mailbox_t *mailbox, qadc_mailbox_snapshot_t *snapshot);
+// Clear the statistics. hist_full_scale sets the range of conversion times covered by the histograms.
+void qadc_stats_init(qadc_stats_t *stats, size_t num_adc, uint32_t hist_full_scale);
+// Count a conversion which crossed the threshold after ticks.
+void qadc_stats_conversion(qadc_stats_t *stats, unsigned adc_idx, int is_up, uint32_t ticks);
+// Count a conversion longer than expected (soft) or which never crossed the threshold (hard).
+void qadc_stats_overshoot(qadc_stats_t *stats, unsigned adc_idx, int is_hard);
+// Track the worst case post processing time.
+void qadc_stats_proc_time(qadc_stats_t *stats, uint32_t ticks);
+// Track the time from the end of a conversion to the next scheduled charge. Negative slack is a missed period.
+void qadc_stats_slack(qadc_stats_t *stats, int32_t slack_ticks);
+// Time for a pot channel's capacitor to settle towards the wiper voltage after the threshold crossing. rc_ticks
+// is the pot end to end resistance times the capacitance. Longest in the middle of travel, zero at the ends.
+uint32_t qadc_pot_settle_ticks(uint32_t rc_ticks, unsigned position, size_t lut_size);
+// Set up QADC_CONVERT_ADAPTIVE scheduling with all channels due now.
+void qadc_adaptive_init(qadc_adaptive_sched_t *sched, size_t num_adc, uint32_t idle_interval_ticks, uint32_t time_now);
+// Record a channel's new result and work out when it is next due.
+void qadc_adaptive_result(qadc_adaptive_sched_t *sched, unsigned adc_idx, uint16_t result, uint32_t time_now);
+// Pick the next channel to convert, in round robin order amongst those due by earliest. If none are due, picks
+// the one due soonest. start_time is when its charge may begin, never before earliest.
+unsigned qadc_adaptive_next(qadc_adaptive_sched_t *sched, uint32_t earliest, uint32_t *start_time);
+#endif
+
+#endif
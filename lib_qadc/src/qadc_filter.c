@@ -0,0 +1,173 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "qadc_core.h"
+
+// Slew adaptive filter treats moves smaller than full_scale >> this as noise
+#define SLEW_NOISE_BAND_SHIFT   6
+
+static unsigned log2_floor(uint32_t val){
+    return val ? 31 - __builtin_clz(val) : 0;
+}
+
+
+uint16_t *qadc_filter_init(qadc_filter_t *filter, qadc_filter_type_t type, size_t depth, unsigned full_scale, size_t num_adc, uint16_t *buffer){
+    assert(depth > 0);
+    assert(QADC_FILTER_TYPE(type) == type && QADC_FILTER_DEPTH(depth) == depth); // Match any build time specialisation
+    filter->type = type;
+    filter->depth = depth;
+    filter->shift = log2_floor(depth);
+    assert(filter->shift <= 15); // Accumulator holds a 16b value shifted up by this
+    unsigned noise_band_log2 = log2_floor(full_scale);
+    filter->slew_shift = noise_band_log2 > SLEW_NOISE_BAND_SHIFT ? noise_band_log2 - SLEW_NOISE_BAND_SHIFT : 0;
+
+    // Word align the accumulators
+    uint16_t *ptr = buffer;
+    if((uintptr_t)ptr & 0x2){
+        ptr++;
+    }
+    filter->accum = (uint32_t *)ptr;
+    ptr += 2 * num_adc;
+
+    if(type == QADC_FILTER_MOVING_AVERAGE){
+        filter->history = ptr;
+        ptr += depth * num_adc;
+        filter->write_idx = ptr;
+        ptr += num_adc;
+    } else {
+        filter->history = NULL;
+        filter->write_idx = NULL;
+    }
+
+    // Return the end of the filter region, not the end of what we used, so the caller's layout is fixed
+    uint16_t *end = buffer + QADC_FILTER_STATE_SIZE(num_adc, type, depth);
+    assert(ptr <= end);
+
+    qadc_filter_reset(filter, num_adc);
+
+    return end;
+}
+
+
+void qadc_filter_reset(qadc_filter_t *filter, size_t num_adc){
+    memset(filter->accum, 0, num_adc * sizeof(uint32_t));
+    if(filter->type == QADC_FILTER_MOVING_AVERAGE){
+        memset(filter->history, 0, num_adc * filter->depth * sizeof(uint16_t));
+        memset(filter->write_idx, 0, num_adc * sizeof(uint16_t));
+    }
+}
+
+
+// Running sum so only the entering and leaving samples need touching
+static inline uint16_t apply_moving_average(qadc_filter_t *filter, unsigned adc_idx, uint16_t raw_result){
+    const size_t depth = QADC_FILTER_DEPTH(filter->depth);
+    uint32_t *accum = &filter->accum[adc_idx];
+    uint16_t *hist_ptr = filter->history + adc_idx * depth + filter->write_idx[adc_idx];
+    *accum += raw_result;
+    *accum -= *hist_ptr;
+    *hist_ptr = raw_result;
+
+    if(++filter->write_idx[adc_idx] == depth){
+        filter->write_idx[adc_idx] = 0;
+    }
+
+    return *accum / depth;
+}
+
+
+// IIR types. Accumulator holds the output scaled up by 1 << shift. Shift must be non-zero.
+static inline uint16_t apply_iir(qadc_filter_t *filter, unsigned adc_idx, uint16_t raw_result, int slew_adaptive){
+    uint32_t *accum = &filter->accum[adc_idx];
+    const unsigned shift = QADC_FILTER_SHIFT(filter->shift);
+    const uint32_t half = 1 << (shift - 1);
+
+    unsigned coeff_shift = shift;
+    if(slew_adaptive){
+        // Take one bit off the time constant for each doubling of the error beyond the noise band
+        uint16_t filtered = (*accum + half - 1) >> shift;
+        uint32_t error = raw_result > filtered ? raw_result - filtered : filtered - raw_result;
+        error >>= filter->slew_shift;
+        if(error){
+            unsigned speedup = log2_floor(error) + 1;
+            coeff_shift = speedup >= shift ? 0 : shift - speedup;
+        }
+    }
+
+    int32_t delta = ((int32_t)raw_result << shift) - (int32_t)*accum;
+    if(coeff_shift){
+        delta = (delta + (1 << (coeff_shift - 1))) >> coeff_shift; // Round so the output settles exactly on a stationary input
+    }
+    *accum += delta;
+
+    return (*accum + half - 1) >> shift;
+}
+
+
+uint16_t qadc_filter_apply(qadc_filter_t *filter, unsigned adc_idx, uint16_t raw_result){
+    const qadc_filter_type_t type = QADC_FILTER_TYPE(filter->type);
+    if(type == QADC_FILTER_MOVING_AVERAGE){
+        return apply_moving_average(filter, adc_idx, raw_result);
+    }
+    if(QADC_FILTER_SHIFT(filter->shift) == 0){
+        filter->accum[adc_idx] = raw_result;
+        return raw_result;
+    }
+    return apply_iir(filter, adc_idx, raw_result, type == QADC_FILTER_SLEW_ADAPTIVE);
+}
+
+
+void qadc_filter_apply_batch(qadc_filter_t *filter, const uint16_t *raw_results, uint16_t *filtered, size_t num_adc){
+    // The same arithmetic as qadc_filter_apply() written out as one loop per filter type. The type and its
+    // constants are decided once for the whole scan and each channel only touches its own accumulator, so the
+    // loops carry no calls, no branches between channels and no dependency from one channel to the next.
+    const qadc_filter_type_t type = QADC_FILTER_TYPE(filter->type);
+    const unsigned shift = QADC_FILTER_SHIFT(filter->shift);
+    uint32_t *accum = filter->accum;
+    num_adc = QADC_NUM_ADC(num_adc);
+
+    if(type == QADC_FILTER_MOVING_AVERAGE){
+        const size_t depth = QADC_FILTER_DEPTH(filter->depth);
+        uint16_t *write_idx = filter->write_idx;
+        uint16_t *history = filter->history;
+        for(size_t i = 0; i < num_adc; i++, history += depth){
+            const uint16_t raw_result = raw_results[i];
+            uint16_t *hist_ptr = history + write_idx[i];
+            accum[i] += raw_result - *hist_ptr;
+            *hist_ptr = raw_result;
+            const unsigned next_idx = write_idx[i] + 1;
+            write_idx[i] = next_idx == depth ? 0 : next_idx;
+            filtered[i] = accum[i] / depth;
+        }
+    } else if(shift == 0){
+        for(size_t i = 0; i < num_adc; i++){
+            accum[i] = raw_results[i];
+            filtered[i] = raw_results[i];
+        }
+    } else if(type == QADC_FILTER_SLEW_ADAPTIVE){
+        const uint32_t half = 1 << (shift - 1);
+        const unsigned slew_shift = filter->slew_shift;
+        for(size_t i = 0; i < num_adc; i++){
+            const uint16_t raw_result = raw_results[i];
+            const uint16_t last = (accum[i] + half - 1) >> shift;
+            const uint32_t error = (raw_result > last ? raw_result - last : last - raw_result) >> slew_shift;
+            const unsigned speedup = error ? log2_floor(error) + 1 : 0;
+            const unsigned coeff_shift = speedup >= shift ? 0 : shift - speedup;
+            int32_t delta = ((int32_t)raw_result << shift) - (int32_t)accum[i];
+            if(coeff_shift){
+                delta = (delta + (1 << (coeff_shift - 1))) >> coeff_shift;
+            }
+            accum[i] += delta;
+            filtered[i] = (accum[i] + half - 1) >> shift;
+        }
+    } else {
+        const uint32_t half = 1 << (shift - 1);
+        for(size_t i = 0; i < num_adc; i++){
+            const int32_t delta = (((int32_t)raw_results[i] << shift) - (int32_t)accum[i] + (int32_t)half) >> shift;
+            accum[i] += delta;
+            filtered[i] = (accum[i] + half - 1) >> shift;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Seqlock style result mailbox. The single writer makes seq odd, updates the scan and then makes seq even
+// again. Readers copy the scan between two reads of seq and retry if it was odd or moved.
+
+#include <string.h>
+#include <assert.h>
+#include "qadc_core.h"
+
+void qadc_mailbox_init(qadc_mailbox_t *mailbox, size_t num_adc){
+    assert(num_adc <= QADC_MAILBOX_MAX_CH); // Increase QADC_MAILBOX_MAX_CH
+    memset(mailbox, 0, sizeof(*mailbox));
+    mailbox->num_adc = num_adc;
+}
+
+
+void qadc_mailbox_stamp(qadc_mailbox_t *mailbox, unsigned adc_idx, uint32_t timestamp){
+    mailbox->pending_timestamps[adc_idx] = timestamp;
+}
+
+
+void qadc_mailbox_publish(qadc_mailbox_t *mailbox, const uint16_t *results){
+    volatile uint32_t *seq = &mailbox->seq;
+    const uint32_t writing = *seq + 1;
+    const uint32_t published = writing + 1;
+    const int first = (writing == 1);
+
+    *seq = writing;
+    QADC_MEMORY_BARRIER();
+    for(unsigned i = 0; i < mailbox->num_adc; i++){
+        if(first || mailbox->results[i] != results[i]){
+            mailbox->results[i] = results[i];
+            mailbox->change_seq[i] = published;
+        }
+        mailbox->timestamps[i] = mailbox->pending_timestamps[i];
+    }
+    QADC_MEMORY_BARRIER();
+    *seq = published;
+}
+
+
+int qadc_mailbox_read(const qadc_mailbox_t *mailbox, qadc_mailbox_snapshot_t *snapshot){
+    const volatile uint32_t *seq = &mailbox->seq;
+    const uint32_t last_seq = snapshot->seq;
+    uint32_t new_data_mask = 0;
+    uint32_t start_seq = 0;
+
+    while(1){
+        start_seq = *seq;
+        if(start_seq & 0x1){
+            continue; // Publish in progress
+        }
+        QADC_MEMORY_BARRIER();
+        new_data_mask = 0;
+        for(unsigned i = 0; i < mailbox->num_adc; i++){
+            snapshot->results[i] = mailbox->results[i];
+            snapshot->timestamps[i] = mailbox->timestamps[i];
+            // Signed difference so the comparison survives seq wrapping
+            if(last_seq == 0 || (int32_t)(mailbox->change_seq[i] - last_seq) > 0){
+                new_data_mask |= 1 << i;
+            }
+        }
+        QADC_MEMORY_BARRIER();
+        if(*seq == start_seq){
+            break;
+        }
+    }
+
+    snapshot->num_adc = mailbox->num_adc;
+    snapshot->new_data_mask = (start_seq == 0) ? 0 : new_data_mask; // Nothing published yet
+    snapshot->seq = start_seq;
+
+    return start_seq != last_seq;
+}
@@ -5,8 +5,44 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include <platform.h>
-#include "qadc_utils.h"
+#include "qadc_core.h"
+
+// Transition time in ticks for LUT position i. Sets is_up if the pot voltage is above the threshold, in which
+// case the capacitor is charged low and the time is to the rising transition, otherwise it is to the falling one.
+static unsigned gen_point(unsigned i, unsigned num_points,
+                          float r_ohms, float capacitor_f, float rs_ohms,
+                          float v_rail, float v_thresh, int *is_up){
+    //TODO rs_ohms
+    const float phi = 1e-10;
+
+    // Calculate equivalent resistance of pot
+    float r_low = r_ohms * (i + phi) / (num_points - 1);  
+    float r_high = r_ohms * ((num_points - i - 1) + phi) / (num_points - 1);  
+    float r_parallel = 1 / (1 / r_low + 1 / r_high); // When reading the equivalent resistance of pot is this
+
+    // Calculate equivalent resistances when charging via Rs
+    float rp_low = 1 / (1 / r_low + 1 / rs_ohms);
+    float rp_high = 1 / (1 / r_high + 1 / rs_ohms);
+
+    // Calculate actual charge voltage of capacitor
+    float v_charge_h = r_low / (r_low + rp_high) * v_rail;
+    float v_charge_l = rp_low / (rp_low + r_high) * v_rail;
+
+    // Calculate time to for cap to reach threshold from charge volatage
+    // https://phys.libretexts.org/Bookshelves/University_Physics/University_Physics_(OpenStax)/Book%3A_University_Physics_II_-_Thermodynamics_Electricity_and_Magnetism_(OpenStax)/10%3A_Direct-Current_Circuits/10.06%3A_RC_Circuits
+    float v_pot = (float)i / (num_points - 1) * v_rail + phi;
+    *is_up = v_pot > v_thresh;
+    if(*is_up){
+        float t_up = (-r_parallel) * capacitor_f * log(1 - ((v_thresh - v_charge_l) / (v_pot - v_charge_l)));
+        // Convert to 100MHz timer ticks. Unreachable positions give a negative or NaN time which must be zero
+        // explicitly since converting those to unsigned is undefined (and differs between xcore and host).
+        return t_up > 0 ? (unsigned)(t_up * XS1_TIMER_HZ) : 0;
+    }
+    float v_down_offset = v_rail - v_charge_h;
+    float t_down = (-r_parallel) * capacitor_f * log(1 - (v_rail - v_thresh - v_down_offset) / (v_rail - v_pot - v_down_offset));  
+    return t_down > 0 ? (unsigned)(t_down * XS1_TIMER_HZ) : 0;
+}
+
 
 void gen_lookup_pot(uint16_t * up, uint16_t * down, unsigned num_points,
                     float r_ohms, float capacitor_f, float rs_ohms,
@@ -20,48 +56,19 @@ void gen_lookup_pot(uint16_t * up, uint16_t * down, unsigned num_points,
     *max_lut_ticks_down = 0;
     *max_lut_ticks_up = 0;
 
-    //TODO rs_ohms
     dprintf("r_ohms: %f capacitor_pf: %f v_rail: %f v_thresh: %f\n", r_ohms, capacitor_f * 1e12, v_rail, v_thresh);
-    const float phi = 1e-10;
 
-    int cross_vref_idx = 0;
     for(unsigned i = 0; i < num_points; i++){
-        // Calculate equivalent resistance of pot
-        float r_low = r_ohms * (i + phi) / (num_points - 1);  
-        float r_high = r_ohms * ((num_points - i - 1) + phi) / (num_points - 1);  
-        float r_parallel = 1 / (1 / r_low + 1 / r_high); // When reading the equivalent resistance of pot is this
-
-        // Calculate equivalent resistances when charging via Rs
-        float rp_low = 1 / (1 / r_low + 1 / rs_ohms);
-        float rp_high = 1 / (1 / r_high + 1 / rs_ohms);
-
-        // Calculate actual charge voltage of capacitor
-        float v_charge_h = r_low / (r_low + rp_high) * v_rail;
-        float v_charge_l = rp_low / (rp_low + r_high) * v_rail;
-
-        // Calculate time to for cap to reach threshold from charge volatage
-        // https://phys.libretexts.org/Bookshelves/University_Physics/University_Physics_(OpenStax)/Book%3A_University_Physics_II_-_Thermodynamics_Electricity_and_Magnetism_(OpenStax)/10%3A_Direct-Current_Circuits/10.06%3A_RC_Circuits
-        float v_pot = (float)i / (num_points - 1) * v_rail + phi;
-        float t_up = (-r_parallel) * capacitor_f * log(1 - ((v_thresh - v_charge_l) / (v_pot - v_charge_l)));
-        float v_down_offset = v_rail - v_charge_h;
-        float t_down = (-r_parallel) * capacitor_f * log(1 - (v_rail - v_thresh - v_down_offset) / (v_rail - v_pot - v_down_offset));  
-
-        // Convert to 100MHz timer ticks
-        unsigned t_down_ticks = (unsigned)(t_down * XS1_TIMER_HZ);
-        unsigned t_up_ticks = (unsigned)(t_up * XS1_TIMER_HZ);
-
-        if(v_pot > v_thresh){
-            up[i] = t_up_ticks;
+        int is_up = 0;
+        unsigned ticks = gen_point(i, num_points, r_ohms, capacitor_f, rs_ohms, v_rail, v_thresh, &is_up);
+        if(is_up){
+            up[i] = ticks;
             *max_lut_ticks_up = up[i] > *max_lut_ticks_up ? up[i] : *max_lut_ticks_up;
-            if(cross_vref_idx == 0){
-                cross_vref_idx = i;
-            }
         } else {
-            down[i] = t_down_ticks;
+            down[i] = ticks;
             *max_lut_ticks_down = down[i] > *max_lut_ticks_down ? down[i] : *max_lut_ticks_down;
         }
-        dprintf("i: %u r_parallel: %f v_pot: %f v_charge_h: %f v_charge_l: %f t_down: %u t_up: %u\n", i, r_parallel, v_pot, v_charge_h, v_charge_l, down[i] , up[i]);
-
+        dprintf("i: %u t_down: %u t_up: %u\n", i, down[i] , up[i]);
     }
 
     dprintf("max_lut_ticks_up: %lu max_lut_ticks_down: %lu\n", *max_lut_ticks_up, *max_lut_ticks_down);
@@ -69,3 +76,73 @@ void gen_lookup_pot(uint16_t * up, uint16_t * down, unsigned num_points,
     assert(*max_lut_ticks_up < 65536); // We have a 16b port timer, so if max is more than this, then we need to slow clock or lower RC
     assert(*max_lut_ticks_down < 65536); // We have a 16b port timer, so if max is more than this, then we need to slow clock or lower RC
 }
+
+
+void gen_lookup_pot_compact(uint16_t * ticks, unsigned num_points,
+                            float r_ohms, float capacitor_f, float rs_ohms,
+                            float v_rail, float v_thresh, unsigned *split_idx,
+                            uint32_t *max_lut_ticks_up, uint32_t *max_lut_ticks_down){
+    *max_lut_ticks_down = 0;
+    *max_lut_ticks_up = 0;
+    *split_idx = num_points;
+
+    for(unsigned i = 0; i < num_points; i++){
+        int is_up = 0;
+        ticks[i] = gen_point(i, num_points, r_ohms, capacitor_f, rs_ohms, v_rail, v_thresh, &is_up);
+        if(is_up){
+            // v_pot rises with i so everything from the first up entry onwards is up
+            *split_idx = i < *split_idx ? i : *split_idx;
+            *max_lut_ticks_up = ticks[i] > *max_lut_ticks_up ? ticks[i] : *max_lut_ticks_up;
+        } else {
+            *max_lut_ticks_down = ticks[i] > *max_lut_ticks_down ? ticks[i] : *max_lut_ticks_down;
+        }
+    }
+
+    dprintf("split_idx: %u max_lut_ticks_up: %lu max_lut_ticks_down: %lu\n", *split_idx, *max_lut_ticks_up, *max_lut_ticks_down);
+
+    assert(*max_lut_ticks_up < 65536); // We have a 16b port timer, so if max is more than this, then we need to slow clock or lower RC
+    assert(*max_lut_ticks_down < 65536); // We have a 16b port timer, so if max is more than this, then we need to slow clock or lower RC
+}
+
+
+void qadc_pot_lut_gen(qadc_pot_lut_t *lut, uint16_t *buffer, size_t lut_size,
+                      float r_ohms, float capacitor_f, float rs_ohms, float v_rail, float v_thresh){
+    gen_lookup_pot_compact(buffer, lut_size, r_ohms, capacitor_f, rs_ohms, v_rail, v_thresh,
+                           &lut->split_idx, &lut->max_lut_ticks_up, &lut->max_lut_ticks_down);
+    qadc_pot_lut_index_build_compact(&lut->index, buffer, lut->split_idx, lut_size);
+
+    lut->ticks = buffer;
+    lut->lut_size = lut_size;
+    lut->crossover_idx = (unsigned)(v_thresh / v_rail * lut_size);
+}
+
+
+uint32_t qadc_pot_lut_cal_scale(uint32_t observed_max, uint32_t ref_max){
+    if(observed_max == 0 || ref_max == 0){
+        return 1 << QADC_POT_CAL_SCALE_SHIFT; // Nothing seen in this direction so leave it as it was
+    }
+    uint64_t scale = ((uint64_t)observed_max << QADC_POT_CAL_SCALE_SHIFT) / ref_max;
+    return scale > UINT32_MAX ? UINT32_MAX : (uint32_t)scale;
+}
+
+
+uint16_t qadc_pot_lut_rescale_ticks(uint32_t ticks, uint32_t scale){
+    uint64_t scaled = ((uint64_t)ticks * scale + (1 << (QADC_POT_CAL_SCALE_SHIFT - 1))) >> QADC_POT_CAL_SCALE_SHIFT;
+    if(scaled > UINT16_MAX){
+        return UINT16_MAX;
+    }
+    // Zero marks an unreachable entry so a reachable one must not round down to it
+    if(ticks != 0 && scaled == 0){
+        return 1;
+    }
+    return (uint16_t)scaled;
+}
+
+
+void qadc_pot_lut_rescale(uint16_t *dst, const uint16_t *ref, unsigned start, unsigned end, unsigned split_idx,
+                          uint32_t scale_down, uint32_t scale_up){
+    // Time to threshold is proportional to RC so a change in R or C scales each direction's curve uniformly
+    for(unsigned i = start; i < end; i++){
+        dst[i] = qadc_pot_lut_rescale_ticks(ref[i], i < split_idx ? scale_down : scale_up);
+    }
+}
@@ -0,0 +1,258 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdint.h>
+#include "qadc_core.h"
+
+// Split the non-zero entries of lut[start, end) into maximal monotonic runs. Returns the number of runs found
+// or QADC_POT_LUT_MAX_RUNS + 1 if the table needs more runs than we have space for.
+static unsigned find_runs(qadc_pot_lut_run_t runs[], const uint16_t * lut, unsigned start, unsigned end){
+    unsigned num_runs = 0;
+    unsigned i = start;
+
+    while(i < end){
+        if(lut[i] == 0){
+            i++;
+            continue;
+        }
+        if(num_runs == QADC_POT_LUT_MAX_RUNS){
+            return QADC_POT_LUT_MAX_RUNS + 1;
+        }
+
+        int dir = 0; // 0 = flat so far, 1 = rising, -1 = falling
+        unsigned j = i;
+        while(j + 1 < end && lut[j + 1] != 0){
+            int step = (lut[j + 1] > lut[j]) - (lut[j + 1] < lut[j]);
+            if(dir == 0){
+                dir = step;
+            } else if(step == -dir){
+                break; // Direction change so start a new run from j + 1
+            }
+            j++;
+        }
+
+        runs[num_runs].start = i;
+        runs[num_runs].end = j;
+        runs[num_runs].is_rising = (dir >= 0);
+        num_runs++;
+        i = j + 1;
+    }
+
+    return num_runs;
+}
+
+
+void qadc_pot_lut_index_build(qadc_pot_lut_index_t *index, const uint16_t * up, const uint16_t * down, unsigned num_points){
+    index->use_linear_search = 0;
+
+    // The down search relies on the up entry being zero wherever the down entry is populated, which
+    // gen_lookup_pot() guarantees. Anything else has to use the reference scan to stay bit exact.
+    for(unsigned i = 0; i < num_points; i++){
+        if(up[i] != 0 && down[i] != 0){
+            index->use_linear_search = 1;
+        }
+    }
+
+    index->num_up_runs = find_runs(index->up_runs, up, 0, num_points);
+    index->num_down_runs = find_runs(index->down_runs, down, 0, num_points);
+
+    if(index->num_up_runs > QADC_POT_LUT_MAX_RUNS || index->num_down_runs > QADC_POT_LUT_MAX_RUNS){
+        index->use_linear_search = 1;
+    }
+
+    dprintf("lut index up runs: %u down runs: %u linear: %u\n", index->num_up_runs, index->num_down_runs, index->use_linear_search);
+}
+
+
+void qadc_pot_lut_index_build_compact(qadc_pot_lut_index_t *index, const uint16_t * ticks, unsigned split_idx, unsigned num_points){
+    // The two directions cannot overlap in the compact table so only the run count can force a scan
+    index->num_up_runs = find_runs(index->up_runs, ticks, split_idx, num_points);
+    index->num_down_runs = find_runs(index->down_runs, ticks, 0, split_idx);
+    index->use_linear_search = (index->num_up_runs > QADC_POT_LUT_MAX_RUNS || index->num_down_runs > QADC_POT_LUT_MAX_RUNS);
+
+    dprintf("compact lut index up runs: %u down runs: %u linear: %u\n", index->num_up_runs, index->num_down_runs, index->use_linear_search);
+}
+
+
+// Last index in [lo, hi] with lut[idx] < ticks for a rising run. Returns -1 if none.
+static inline int last_below_rising(const uint16_t * lut, int lo, int hi, uint16_t ticks){
+    int found = -1;
+    while(lo <= hi){
+        int mid = (lo + hi) >> 1;
+        if(lut[mid] < ticks){
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+// First index in [lo, hi] with lut[idx] < ticks for a falling run. Returns -1 if none.
+static inline int first_below_falling(const uint16_t * lut, int lo, int hi, uint16_t ticks){
+    int found = -1;
+    while(lo <= hi){
+        int mid = (lo + hi) >> 1;
+        if(lut[mid] < ticks){
+            found = mid;
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return found;
+}
+
+// Last index in [lo, hi] with lut[idx] >= val for a falling run. lut[lo] must be >= val.
+static inline int last_at_least_falling(const uint16_t * lut, int lo, int hi, uint16_t val){
+    int found = lo;
+    while(lo <= hi){
+        int mid = (lo + hi) >> 1;
+        if(lut[mid] >= val){
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+
+unsigned qadc_pot_lut_search_linear(const uint16_t * up, const uint16_t * down, unsigned num_points, int is_up, uint16_t ticks){
+    unsigned max_arg = 0;
+
+    if(is_up){
+        uint16_t max = 0;
+        max_arg = num_points - 1;
+        for(int i = num_points - 1; i >= 0; i--){
+            if(ticks > up[i]){
+                if(up[i] > max){
+                    max_arg = i;
+                    max = up[i];
+                }
+            }
+        }
+    } else {
+        int16_t max = 0;
+        for(int i = 0; i < num_points; i++){
+            if(ticks > down[i]){
+                if(down[i] > max){
+                    max_arg = i;
+                    max = up[i];
+                }
+            }
+        }
+    }
+
+    return max_arg;
+}
+
+
+// Binary search of the indexed runs. The runs only cover populated entries of their own direction, so up
+// and down may point to the same compact table.
+static inline unsigned search_runs(const qadc_pot_lut_index_t *index, const uint16_t * up, const uint16_t * down, unsigned num_points, int is_up, uint16_t ticks){
+    if(is_up){
+        // Largest entry below ticks, taking the highest index where entries are equal. Default is full scale.
+        uint16_t max = 0;
+        unsigned max_arg = num_points - 1;
+        for(unsigned r = 0; r < index->num_up_runs; r++){ // Runs are in ascending index order
+            const qadc_pot_lut_run_t *run = &index->up_runs[r];
+            int idx = 0;
+            if(run->is_rising){
+                idx = last_below_rising(up, run->start, run->end, ticks);
+                if(idx < 0) continue;
+            } else {
+                idx = first_below_falling(up, run->start, run->end, ticks);
+                if(idx < 0) continue;
+                idx = last_at_least_falling(up, idx, run->end, up[idx]);
+            }
+            if(up[idx] >= max){
+                max = up[idx];
+                max_arg = idx;
+            }
+        }
+        return max_arg;
+    } else {
+        // Highest index with a populated entry below ticks. Default is zero scale.
+        for(int r = index->num_down_runs - 1; r >= 0; r--){
+            const qadc_pot_lut_run_t *run = &index->down_runs[r];
+            if(run->is_rising){
+                int idx = last_below_rising(down, run->start, run->end, ticks);
+                if(idx >= 0) return idx;
+            } else if(down[run->end] < ticks){
+                return run->end;
+            }
+        }
+        return 0;
+    }
+}
+
+
+unsigned qadc_pot_lut_search(const qadc_pot_lut_index_t *index, const uint16_t * up, const uint16_t * down, unsigned num_points, int is_up, uint16_t ticks){
+    if(index->use_linear_search){
+        return qadc_pot_lut_search_linear(up, down, num_points, is_up, ticks);
+    }
+    return search_runs(index, up, down, num_points, is_up, ticks);
+}
+
+
+unsigned qadc_pot_lut_search_compact_linear(const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks){
+    // Same as qadc_pot_lut_search_linear() with the other direction's entries treated as zero
+    if(is_up){
+        uint16_t max = 0;
+        unsigned max_arg = num_points - 1;
+        for(int i = num_points - 1; i >= (int)split_idx; i--){
+            if(ticks > ticks_lut[i] && ticks_lut[i] > max){
+                max_arg = i;
+                max = ticks_lut[i];
+            }
+        }
+        return max_arg;
+    } else {
+        unsigned max_arg = 0;
+        for(unsigned i = 0; i < split_idx; i++){
+            if(ticks > ticks_lut[i] && ticks_lut[i] > 0){
+                max_arg = i;
+            }
+        }
+        return max_arg;
+    }
+}
+
+
+unsigned qadc_pot_lut_search_compact(const qadc_pot_lut_index_t *index, const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks){
+    if(index->use_linear_search){
+        return qadc_pot_lut_search_compact_linear(ticks_lut, split_idx, num_points, is_up, ticks);
+    }
+    return search_runs(index, ticks_lut, ticks_lut, num_points, is_up, ticks);
+}
+
+
+uint32_t qadc_pot_lut_interpolate(const uint16_t * ticks_lut, unsigned split_idx, unsigned num_points, int is_up, uint16_t ticks, unsigned idx, unsigned frac_bits){
+    const uint32_t posn = (uint32_t)idx << frac_bits;
+    if(frac_bits == 0 || ticks_lut[idx] >= ticks){
+        return posn; // End stop or the search fell back to a default
+    }
+
+    // The search found an entry below ticks. Find the neighbour at or above ticks, in the same direction's part
+    // of the table, which brackets it. Where both do, the nearer in ticks is the better local fit of the curve.
+    const unsigned lo = is_up ? split_idx : 0;
+    const unsigned hi = is_up ? num_points : split_idx;
+    int neighbour = -1;
+    if(idx > lo && ticks_lut[idx - 1] >= ticks){
+        neighbour = idx - 1;
+    }
+    if(idx + 1 < hi && ticks_lut[idx + 1] >= ticks && (neighbour < 0 || ticks_lut[idx + 1] < ticks_lut[neighbour])){
+        neighbour = idx + 1;
+    }
+    if(neighbour < 0){
+        return posn;
+    }
+
+    // Linear between the two entries, which is a close fit to the RC curve over one LUT step
+    const uint32_t span = ticks_lut[neighbour] - ticks_lut[idx];
+    const uint32_t frac = ((uint32_t)(ticks - ticks_lut[idx]) << frac_bits) / span;
+    return neighbour > (int)idx ? posn + frac : posn - frac;
+}
@@ -0,0 +1,77 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Compile time specialisation. Where a product has a single fixed QADC configuration, defining any of the
+// QADC_STATIC_xxx values below in the build flags replaces the matching run time value in the conversion
+// path with a constant. The compiler can then turn divides and modulos into shifts and drop branches
+// which can never be taken. Each accessor takes the run time value and either passes it through or
+// replaces it with the constant, and initialisation asserts that the two agree.
+//
+// The values are build wide. They apply to every potentiometer and rheostat instance, including both halves
+// of qadc_mixed_task(), with no per instance form, so one build supports one configuration only. Leave
+// them undefined for the generic library or where instances differ in any value defined. A mismatch is
+// only caught by the assert at run time.
+//
+// Only the constants are substituted; the tasks themselves are unchanged. There is no separate specialised
+// task and no fixed size static state buffer, as the application still declares the state buffer (the size
+// macros simply fold to constants when given constants). The port_width == 1 tests in the potentiometer
+// select cases stay in the source and are only folded if the compiler chooses to. The saving has been
+// measured on the host only (see tests/qadc_host_core), not in xcore cycles.
+//
+//   QADC_STATIC_NUM_ADC           num_adc of every instance
+//   QADC_STATIC_PORT_WIDTH        Potentiometer port width in bits
+//   QADC_STATIC_LUT_SIZE          Potentiometer lut_size
+//   QADC_STATIC_ADC_STEPS         Rheostat adc_steps
+//   QADC_STATIC_MAX_DISCH_TICKS   Rheostat max_disch_ticks as calculated from qadc_config_t at initialisation
+//   QADC_STATIC_FILTER_TYPE       filter_type in qadc_config_t
+//   QADC_STATIC_FILTER_DEPTH      filter_depth
+
+#ifndef __QADC_STATIC__
+#define __QADC_STATIC__
+
+#ifdef QADC_STATIC_NUM_ADC
+#define QADC_NUM_ADC(num_adc)                   (QADC_STATIC_NUM_ADC)
+#else
+#define QADC_NUM_ADC(num_adc)                   (num_adc)
+#endif
+
+#ifdef QADC_STATIC_PORT_WIDTH
+#define QADC_PORT_WIDTH(port_width)             (QADC_STATIC_PORT_WIDTH)
+#else
+#define QADC_PORT_WIDTH(port_width)             (port_width)
+#endif
+
+#ifdef QADC_STATIC_LUT_SIZE
+#define QADC_LUT_SIZE(lut_size)                 (QADC_STATIC_LUT_SIZE)
+#else
+#define QADC_LUT_SIZE(lut_size)                 (lut_size)
+#endif
+
+#ifdef QADC_STATIC_ADC_STEPS
+#define QADC_ADC_STEPS(adc_steps)               (QADC_STATIC_ADC_STEPS)
+#else
+#define QADC_ADC_STEPS(adc_steps)               (adc_steps)
+#endif
+
+#ifdef QADC_STATIC_MAX_DISCH_TICKS
+#define QADC_MAX_DISCH_TICKS(max_disch_ticks)   (QADC_STATIC_MAX_DISCH_TICKS)
+#else
+#define QADC_MAX_DISCH_TICKS(max_disch_ticks)   (max_disch_ticks)
+#endif
+
+#ifdef QADC_STATIC_FILTER_TYPE
+#define QADC_FILTER_TYPE(filter_type)           (QADC_STATIC_FILTER_TYPE)
+#else
+#define QADC_FILTER_TYPE(filter_type)           (filter_type)
+#endif
+
+#ifdef QADC_STATIC_FILTER_DEPTH
+#define QADC_FILTER_DEPTH(depth)                (QADC_STATIC_FILTER_DEPTH)
+// log2 of the depth as qadc_filter_init() works it out, folded to a constant. C only.
+#define QADC_FILTER_SHIFT(shift)                (31 - __builtin_clz(QADC_STATIC_FILTER_DEPTH))
+#else
+#define QADC_FILTER_DEPTH(depth)                (depth)
+#define QADC_FILTER_SHIFT(shift)                (shift)
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdint.h>
+#include <string.h>
+#include "qadc_core.h"
+
+
+void qadc_stats_init(qadc_stats_t *stats, size_t num_adc, uint32_t hist_full_scale){
+    memset(stats, 0, sizeof(*stats));
+    stats->num_adc = num_adc;
+    stats->hist_full_scale = hist_full_scale > 0 ? hist_full_scale : 1;
+    stats->min_slack_ticks = INT32_MAX;
+    for(unsigned i = 0; i < QADC_STATS_MAX_CH; i++){
+        stats->min_ticks[i][0] = UINT16_MAX;
+        stats->min_ticks[i][1] = UINT16_MAX;
+    }
+}
+
+
+void qadc_stats_conversion(qadc_stats_t *stats, unsigned adc_idx, int is_up, uint32_t ticks){
+    const unsigned dir = is_up != 0;
+
+    unsigned bin = (uint64_t)ticks * QADC_STATS_HIST_BINS / stats->hist_full_scale;
+    if(bin >= QADC_STATS_HIST_BINS){
+        bin = QADC_STATS_HIST_BINS - 1; // Top bin also holds anything beyond full scale
+    }
+    stats->histogram[dir][bin]++;
+
+    if(adc_idx >= QADC_STATS_MAX_CH){
+        return;
+    }
+    stats->conversions[adc_idx]++;
+    uint16_t t = ticks > UINT16_MAX ? UINT16_MAX : ticks;
+    if(t < stats->min_ticks[adc_idx][dir]){
+        stats->min_ticks[adc_idx][dir] = t;
+    }
+    if(t > stats->max_ticks[adc_idx][dir]){
+        stats->max_ticks[adc_idx][dir] = t;
+    }
+}
+
+
+void qadc_stats_overshoot(qadc_stats_t *stats, unsigned adc_idx, int is_hard){
+    if(adc_idx >= QADC_STATS_MAX_CH){
+        return;
+    }
+    if(is_hard){
+        stats->hard_overshoots[adc_idx]++;
+    } else {
+        stats->soft_overshoots[adc_idx]++;
+    }
+}
+
+
+void qadc_stats_proc_time(qadc_stats_t *stats, uint32_t ticks){
+    if(ticks > stats->max_proc_ticks){
+        stats->max_proc_ticks = ticks;
+    }
+}
+
+
+void qadc_stats_slack(qadc_stats_t *stats, int32_t slack_ticks){
+    if(slack_ticks < 0){
+        stats->missed_periods++;
+    }
+    if(slack_ticks < stats->min_slack_ticks){
+        stats->min_slack_ticks = slack_ticks;
+    }
+}
@@ -5,9 +5,8 @@
 #define __ADC_UTILS__
 
 #include <stdint.h>
-
-// #define dprintf(...) printf(__VA_ARGS__) 
-#define dprintf(...) 
+#include "qadc.h"
+#include "qadc_core.h"
 
 // Pad control defines
 #define PULL_NONE       0x0
@@ -43,17 +42,89 @@
 #define set_pad_drive_mode(port, drive_mode)  {__asm__ __volatile__ ("setc res[%0], %1": : "r" (port) , "r" ((drive_mode << DRIVE_MODE_SHIFT) | \
                                                                                                             XS1_SETC_DRIVE_DRIVE)) ;}
 
+// Output one word, without an END token, on the streaming chanend attached with qadc_pot_attach_push() or
+// qadc_rheo_attach_push(). The word waits in the channel so the task does not block unless the buffer is full.
+#define qadc_push_word(c_push, word)  {__asm__ __volatile__ ("out res[%0], %1": : "r" (c_push) , "r" (word));}
+
+// Conversion state of the tasks, shared by qadc_pot.xc, qadc_rheo.xc and qadc_mixed.xc
+typedef enum adc_state_t{
+        ADC_STOPPED = 3,
+        ADC_IDLE = 2,
+        ADC_CHARGING = 1,
+        ADC_CONVERTING = 0 // Optimisation as ISA can do != 0 on select guard
+}adc_state_t;
+
+// Streaming state held by the conversion tasks. The task only ever sends on the client's channel in reply to a
+// command, so a frame is collected by the client with QADC_CMD_STREAM_READ. With a push chanend attached the
+// client is told once that a frame is ready and not again until it has read it.
+typedef struct qadc_stream_state_t{
+        int on;
+        uint32_t scans;                                     // Scans completed since the last frame was read
+        unsigned c_push;                                    // Resource id of the push chanend, zero if none
+        int pushed;                                         // QADC_PUSH_STREAM sent and not yet read
+}qadc_stream_state_t;
+
+// Change notification state held by the conversion tasks. Channels which qualify at the end of a scan are
+// held in pending until the client collects them with QADC_CMD_NOTIFY_READ. With a push chanend attached the
+// client is told once that pending has become non-zero and not again until it has read them.
+typedef struct qadc_notify_state_t{
+        uint32_t pending;
+        unsigned c_push;                                    // Resource id of the push chanend, zero if none
+        int pushed;                                         // QADC_PUSH_NOTIFY sent and not yet read
+        uint16_t delta[QADC_NOTIFY_MAX_CH];                 // Zero when not subscribed
+        uint16_t last_result[QADC_NOTIFY_MAX_CH];           // Value most recently notified
+        uint32_t min_interval_ticks[QADC_NOTIFY_MAX_CH];
+        uint32_t last_time[QADC_NOTIFY_MAX_CH];             // Time of the most recent notification
+}qadc_notify_state_t;
+
 #ifdef __XC__
-float find_threshold_level(float v_rail, port p_adc);
-void gen_lookup_pot(uint16_t * unsafe up, uint16_t * unsafe down, unsigned num_points,
-                    float r_ohms, float capacitor_f, float rs_ohms,
-                    float v_rail, float v_thresh,
-                    uint32_t * unsafe max_lut_ticks_up, uint32_t * unsafe max_lut_ticks_down);
-#else
-void gen_lookup_pot(uint16_t * up, uint16_t * down, unsigned num_points,
-                    float r_ohms, float capacitor_f, float rs_ohms,
-                    float v_rail, float v_thresh,
-                    uint32_t *max_lut_ticks_up, uint32_t *max_lut_ticks_down);
+// Send num_adc result words in one transaction. dirs may be NULL, otherwise it is packed at QADC_RESULT_DIR_SHIFT.
+void qadc_send_results(chanend ?c_adc, uint16_t * unsafe results, uint16_t * unsafe dirs, size_t num_adc);
+// c_push is the resource id of the instance's push chanend, zero if none is attached.
+void qadc_stream_init(qadc_stream_state_t &stream_state, unsigned c_push);
+// Handle the stream commands, replying to QADC_CMD_STREAM_READ. dirs may be NULL as for qadc_send_results().
+// Returns 1 if the command was one of them.
+int qadc_stream_command(chanend ?c_adc, uint32_t command, qadc_stream_state_t &stream_state, uint16_t * unsafe results, uint16_t * unsafe dirs, size_t num_adc);
+// Call at the end of each full scan of the channels. Counts the scans for the next frame and pushes
+// QADC_PUSH_STREAM if a push chanend is attached.
+void qadc_stream_scan_complete(qadc_stream_state_t &stream_state);
+
+// Reply to QADC_CMD_GET_STATS. stats may be NULL in which case zeros are sent.
+void qadc_send_stats(chanend ?c_adc, uint32_t command, qadc_stats_t * unsafe stats);
+// c_push is the resource id of the instance's push chanend, zero if none is attached.
+void qadc_notify_init(qadc_notify_state_t &notify_state, unsigned c_push);
+// Handle the subscription commands, replying to QADC_CMD_NOTIFY_READ. Returns 1 if the command was one of them.
+int qadc_notify_command(chanend ?c_adc, uint32_t command, qadc_notify_state_t &notify_state, uint16_t * unsafe results, size_t num_adc);
+// Call at the end of each full scan of the channels. Marks any subscribed channel which has moved as pending and
+// pushes QADC_PUSH_NOTIFY if a push chanend is attached.
+void qadc_notify_scan_complete(qadc_notify_state_t &notify_state, uint16_t * unsafe results, size_t num_adc);
+
+// Conversion slot primitives. The split-phase single shot API, the event engine and qadc_mixed_task() drive one
+// conversion at a time through these, with its progress held in the instance's single state. Init checks the instance timing. Charge
+// starts charging a channel, release starts its conversion once time_trigger_start_convert has passed, and then
+// either the port event or the overshoot completes it. The pot event returns zero if another pin of a wide port moved.
+void qadc_pot_slot_init(qadc_pot_state_t &adc_pot_state);
+void qadc_pot_slot_charge(port p_adc[], unsigned adc_idx, qadc_pot_state_t &adc_pot_state, int32_t time_charge);
+void qadc_pot_slot_release(port p_adc[], qadc_pot_state_t &adc_pot_state, int32_t time_now);
+int qadc_pot_slot_event(qadc_pot_state_t &adc_pot_state, unsigned port_val, int16_t end_time);
+void qadc_pot_slot_overshoot(qadc_pot_state_t &adc_pot_state);
+void qadc_rheo_slot_init(port p_adc[], qadc_rheo_state_t &adc_rheo_state);
+void qadc_rheo_slot_charge(port p_adc[], unsigned adc_idx, qadc_rheo_state_t &adc_rheo_state, int32_t time_charge);
+void qadc_rheo_slot_release(port p_adc[], qadc_rheo_state_t &adc_rheo_state, int32_t time_now);
+void qadc_rheo_slot_event(qadc_rheo_state_t &adc_rheo_state, int16_t end_time, int calibrating);
+void qadc_rheo_slot_overshoot(port p_adc[], qadc_rheo_state_t &adc_rheo_state);
+
+// With batch_post_process, post process all results held since the last flush. Call at the end of each scan,
+// and after a single shot conversion, before the results are read. Does nothing if none are held.
+void qadc_pot_batch_flush(qadc_pot_state_t &adc_pot_state);
+void qadc_rheo_batch_flush(qadc_rheo_state_t &adc_rheo_state);
+
+// Calibration command handling shared with qadc_mixed_task(). The pot step rebuilds a chunk of the LUT per scan.
+void qadc_pot_cal_start(qadc_pot_state_t &adc_pot_state);
+void qadc_pot_cal_finish(qadc_pot_state_t &adc_pot_state);
+void qadc_pot_cal_step(qadc_pot_state_t &adc_pot_state);
+void qadc_rheo_cal_start(qadc_rheo_state_t &adc_rheo_state);
+void qadc_rheo_cal_finish(qadc_rheo_state_t &adc_rheo_state);
 #endif
 
 // For checking if running under sim or not
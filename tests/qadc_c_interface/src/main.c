@@ -5,6 +5,9 @@
 #include <xs1.h>
 #include <print.h>
 #include <xcore/hwtimer.h>
+#include <xcore/port.h>
+#include <xcore/channel_streaming.h>
+#include <xcore/select.h>
 
 #include "qadc.h"
 
@@ -17,14 +20,130 @@
 
 port_t p_adc_pot[] = {XS1_PORT_1A, XS1_PORT_1B};
 port_t p_adc_rheo[] = {XS1_PORT_1C, XS1_PORT_1D};
+port_t p_adc_single[] = {XS1_PORT_1E};
+port_t p_adc_mixed_pot[] = {XS1_PORT_1F};
+port_t p_adc_mixed_rheo[] = {XS1_PORT_1G};
+port_t p_adc_event[] = {XS1_PORT_1H};
+
+// Drive one scan of an instance from this thread's own event loop using the event API
+static void event_loop_scan(qadc_pot_state_t *adc_pot_state){
+    hwtimer_t tmr = hwtimer_alloc();
+    int scan_complete = 0;
+
+    qadc_pot_event_start(p_adc_event, adc_pot_state);
+    while(!scan_complete){
+        unsigned port_idx = 0;
+        unsigned pin_value = 0;
+        int wait_port = qadc_pot_event_port(adc_pot_state, &port_idx, &pin_value);
+        if(wait_port){
+            port_set_trigger_in_not_equal(p_adc_event[port_idx], pin_value);
+        }
+        hwtimer_set_trigger_time(tmr, qadc_pot_event_time(adc_pot_state));
+
+        SELECT_RES(
+            CASE_GUARD_THEN(p_adc_event[port_idx], wait_port, event_pins),
+            CASE_THEN(tmr, event_timer))
+        {
+            event_pins:{
+                uint32_t port_val = port_in(p_adc_event[port_idx]);
+                int16_t port_time = port_get_trigger_time(p_adc_event[port_idx]);
+                port_clear_trigger_in(p_adc_event[port_idx]);
+                scan_complete = qadc_pot_event_pins(adc_pot_state, port_val, port_time);
+            }
+            break;
+            event_timer:{
+                scan_complete = qadc_pot_event_timer(p_adc_event, adc_pot_state);
+            }
+            break;
+        }
+    }
+
+    qadc_pot_event_stop(p_adc_event, adc_pot_state);
+    hwtimer_free(tmr);
+}
+
+// Poll for the next stream frame, reading the results in between to show that other commands may be mixed in
+static void stream_one_frame(chanend_t c_adc, uint32_t results[], size_t num_adc){
+    while(qadc_stream_read(c_adc, results, num_adc) == 0){
+        qadc_read_all(c_adc, results, num_adc);
+        uint32_t time_poll = get_reference_time();
+        while((int32_t)(get_reference_time() - time_poll) < XS1_TIMER_KHZ / 10);
+    }
+}
+
+// Wait for the task to push that a stream frame is ready and collect it. A word pushed before the previous
+// STREAM_STOP may find no new scan, in which case wait for the next one.
+static void stream_one_frame_push(chanend_t c_adc, chanend_t c_push, uint32_t results[], size_t num_adc){
+    do{
+        uint32_t word = s_chan_in_word(c_push);
+        if(word != (uint32_t)QADC_PUSH_STREAM){
+            printstr("Unexpected push word\n"); // Nothing moves in the sim so no notification is pushed
+        }
+    }while(qadc_stream_read(c_adc, results, num_adc) == 0);
+}
+
+DECLARE_JOB(client, (chanend_t, chanend_t, chanend_t, chanend_t, qadc_config_t));
+void client(chanend_t c_adc_pot, chanend_t c_push_pot, chanend_t c_adc_rheo, chanend_t c_adc_mixed, qadc_config_t adc_config){
+    uint32_t results[NUM_ADC];
+
+    // Split-phase single shot on a channel owned by this thread
+    qadc_pot_state_t adc_single_state;
+    uint16_t state_buffer_single[QADC_POT_STATE_SIZE(1, LUT_SIZE, FILTER_DEPTH)];
+    qadc_pre_init_c(p_adc_single, 1);
+    qadc_pot_init(p_adc_single, 1, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer_single, adc_config, &adc_single_state);
+    qadc_pot_single_start(p_adc_single, 0, &adc_single_state);
+    while(!qadc_pot_single_poll(p_adc_single, &adc_single_state)){
+        // Free to do other work here
+    }
+    qadc_pot_single_complete(p_adc_single, &adc_single_state);
+
+    // Continuous conversion without a task, serviced by the client's own event loop
+    qadc_pot_state_t adc_event_state;
+    uint16_t state_buffer_event[QADC_POT_STATE_SIZE(1, LUT_SIZE, FILTER_DEPTH)];
+    qadc_pre_init_c(p_adc_event, 1);
+    qadc_pot_init(p_adc_event, 1, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer_event, adc_config, &adc_event_state);
+    event_loop_scan(&adc_event_state);
+
+    // Block read then one stream frame from each task, pushed by the pot task and polled from the others with
+    // other commands mixed in while streaming
+    qadc_read_all(c_adc_pot, results, NUM_ADC);
+    chan_out_word(c_adc_pot, (uint32_t)QADC_CMD_STREAM_START);
+    stream_one_frame_push(c_adc_pot, c_push_pot, results, NUM_ADC);
+    chan_out_word(c_adc_pot, (uint32_t)QADC_CMD_STREAM_STOP);
+    qadc_read_all(c_adc_rheo, results, NUM_ADC);
+    chan_out_word(c_adc_rheo, (uint32_t)QADC_CMD_STREAM_START);
+    stream_one_frame(c_adc_rheo, results, NUM_ADC);
+    chan_out_word(c_adc_rheo, (uint32_t)QADC_CMD_STREAM_STOP);
+
+    // One pot and one rheo channel from the mixed task, numbered pot first
+    qadc_read_all(c_adc_mixed, results, 2);
+    chan_out_word(c_adc_mixed, (uint32_t)QADC_CMD_STREAM_START);
+    stream_one_frame(c_adc_mixed, results, 2);
+    chan_out_word(c_adc_mixed, (uint32_t)QADC_CMD_STREAM_STOP);
+    qadc_read_all(c_adc_mixed, results, 2);
+
+    // Subscribe, read the notifications while streaming and unsubscribe. Nothing moves in the sim so none are
+    // expected, and only stream frames are pushed on c_push_pot.
+    uint32_t notifications[NUM_ADC];
+    qadc_subscribe(c_adc_pot, 1, 2, XS1_TIMER_KHZ);
+    chan_out_word(c_adc_pot, (uint32_t)QADC_CMD_STREAM_START);
+    stream_one_frame_push(c_adc_pot, c_push_pot, results, NUM_ADC);
+    qadc_notify_read(c_adc_pot, notifications, NUM_ADC);
+    chan_out_word(c_adc_pot, (uint32_t)QADC_CMD_STREAM_STOP);
+    qadc_subscribe(c_adc_pot, 1, 0, 0);
+    qadc_read_all(c_adc_pot, results, NUM_ADC);
+    qadc_subscribe(c_adc_rheo, 0, 2, XS1_TIMER_KHZ);
+    qadc_notify_read(c_adc_rheo, notifications, NUM_ADC);
+    qadc_subscribe(c_adc_rheo, 0, 0, 0);
+    qadc_read_all(c_adc_rheo, results, NUM_ADC);
 
-DECLARE_JOB(client, (chanend_t, chanend_t));
-void client(chanend_t c_adc_pot, chanend_t c_adc_rheo){
     printstr("Client 0\n");
     chan_out_word(c_adc_pot, (uint32_t)QADC_CMD_EXIT);
     printstr("Client 1\n");
     chan_out_word(c_adc_rheo, (uint32_t)QADC_CMD_EXIT);
     printstr("Client 2\n");
+    chan_out_word(c_adc_mixed, (uint32_t)QADC_CMD_EXIT);
+    printstr("Client 3\n");
 }
 
 DECLARE_JOB(qadc_rheo_task_wrapper, (chanend_t, port_t *, qadc_config_t));
@@ -38,18 +157,37 @@ void qadc_rheo_task_wrapper(chanend_t c_adc_rheo, port_t *p_adc,  qadc_config_t
     qadc_rheo_task(c_adc_rheo, p_adc, &adc_rheo_state);
 }
 
-DECLARE_JOB(qadc_pot_task_wrapper, (chanend_t, port_t *, qadc_config_t));
-void qadc_pot_task_wrapper(chanend_t c_adc_pot, port_t *p_adc, qadc_config_t adc_config){
+DECLARE_JOB(qadc_pot_task_wrapper, (chanend_t, chanend_t, port_t *, qadc_config_t));
+void qadc_pot_task_wrapper(chanend_t c_adc_pot, chanend_t c_push_pot, port_t *p_adc, qadc_config_t adc_config){
     qadc_pot_state_t adc_pot_state;
     uint16_t state_buffer_pot[QADC_POT_STATE_SIZE(NUM_ADC, LUT_SIZE, FILTER_DEPTH)];
 
     qadc_pre_init_c(p_adc_pot, NUM_ADC);
     qadc_pot_init(p_adc_pot, NUM_ADC, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer_pot, adc_config, &adc_pot_state);
+    qadc_pot_attach_push(&adc_pot_state, c_push_pot);
     printstr("Init 2\n");
 
     qadc_pot_task(c_adc_pot, p_adc, &adc_pot_state);
 }
 
+DECLARE_JOB(qadc_mixed_task_wrapper, (chanend_t, qadc_config_t));
+void qadc_mixed_task_wrapper(chanend_t c_adc_mixed, qadc_config_t adc_config){
+    qadc_pot_state_t adc_pot_state;
+    qadc_rheo_state_t adc_rheo_state;
+    qadc_mixed_state_t adc_mixed_state;
+    uint16_t state_buffer_pot[QADC_POT_STATE_SIZE(1, LUT_SIZE, FILTER_DEPTH)];
+    uint16_t state_buffer_rheo[QADC_RHEO_STATE_SIZE(1, FILTER_DEPTH)];
+
+    qadc_pre_init_c(p_adc_mixed_pot, 1);
+    qadc_pre_init_c(p_adc_mixed_rheo, 1);
+    qadc_pot_init(p_adc_mixed_pot, 1, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer_pot, adc_config, &adc_pot_state);
+    qadc_rheo_init(p_adc_mixed_rheo, 1, NUM_STEPS, FILTER_DEPTH, HYSTERESIS, state_buffer_rheo, adc_config, &adc_rheo_state);
+    qadc_mixed_init(&adc_mixed_state, &adc_pot_state, &adc_rheo_state);
+    printstr("Init 3\n");
+
+    qadc_mixed_task(c_adc_mixed, p_adc_mixed_pot, p_adc_mixed_rheo, &adc_mixed_state);
+}
+
 
 int main(void){
     // Note this struct init is parsed in the rst docs
@@ -62,14 +200,17 @@ int main(void){
                                         .convert_interval_ticks = 1 * XS1_TIMER_KHZ};
 
     channel_t c_adc_pot = chan_alloc();
+    streaming_channel_t c_push_pot = s_chan_alloc();
     channel_t c_adc_rheo = chan_alloc();
+    channel_t c_adc_mixed = chan_alloc();
 
     printstr("Init 0\n");
 
     PAR_JOBS(
-        PJOB(qadc_pot_task_wrapper, (c_adc_pot.end_a, p_adc_pot, adc_config)),
+        PJOB(qadc_pot_task_wrapper, (c_adc_pot.end_a, c_push_pot.end_a, p_adc_pot, adc_config)),
         PJOB(qadc_rheo_task_wrapper, (c_adc_rheo.end_a, p_adc_rheo, adc_config)),
-        PJOB(client, (c_adc_pot.end_b, c_adc_rheo.end_b))
+        PJOB(qadc_mixed_task_wrapper, (c_adc_mixed.end_a, adc_config)),
+        PJOB(client, (c_adc_pot.end_b, c_push_pot.end_b, c_adc_rheo.end_b, c_adc_mixed.end_b, adc_config))
     );
 
     printstr("Success!\n");
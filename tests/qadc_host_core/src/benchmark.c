@@ -0,0 +1,191 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Host micro-benchmark for the portable QADC core. Reports LUT generation time and the cost of the
+// per-conversion maths (ticks to position plus post processing) across lut_size, filter_depth and num_adc.
+//   qadc_core_benchmark [conversions_per_config]
+// Numbers are host ns so only meaningful relative to each other, e.g. before and after a change.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "qadc_core.h"
+
+#define MAX_LUT_SIZE    2048
+#define MAX_ADC         8
+#define MAX_DEPTH       128
+#define NUM_TICKS       4096 // Pre-generated inputs so rand() is not timed
+
+static const unsigned lut_sizes[] = {256, 512, 1024, 2048};
+static const unsigned filter_depths[] = {8, 32, 128};
+static const unsigned num_adcs[] = {1, 4, 8};
+static const qadc_filter_type_t filter_types[] = {QADC_FILTER_MOVING_AVERAGE, QADC_FILTER_IIR, QADC_FILTER_SLEW_ADAPTIVE};
+static const char *filter_names[] = {"ma", "iir", "slew"};
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof(a[0]))
+
+static uint16_t lut_buffer[QADC_POT_LUT_BUFFER_SIZE(MAX_LUT_SIZE)];
+static uint16_t filter_buffer[QADC_FILTER_STATE_SIZE(MAX_ADC, QADC_FILTER_MOVING_AVERAGE, MAX_DEPTH)];
+static uint16_t hysteris_tracker[MAX_ADC];
+static uint16_t raw_results[MAX_ADC];
+static uint16_t results[MAX_ADC];
+static uint16_t max_seen_ticks[MAX_ADC];
+static qadc_q3_13_fixed_t max_scale[MAX_ADC];
+static uint16_t ticks_in[NUM_TICKS];
+static uint8_t dir_in[NUM_TICKS];
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static double bench_lut_gen(unsigned lut_size, qadc_pot_lut_t *lut){
+    const unsigned reps = 10;
+    uint64_t t0 = now_ns();
+    for(unsigned r = 0; r < reps; r++){
+        qadc_pot_lut_gen(lut, lut_buffer, lut_size, 47000, 2200e-12, 470, 3.3, 1.15);
+    }
+    return (double)(now_ns() - t0) / reps / 1000.0;
+}
+
+
+static double bench_pot(unsigned lut_size, unsigned depth, unsigned num_adc, qadc_filter_type_t type,
+                        const qadc_pot_lut_t *lut, unsigned conversions){
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, type, depth, lut_size - 1, num_adc, filter_buffer);
+    for(unsigned ch = 0; ch < num_adc; ch++){
+        hysteris_tracker[ch] = 0;
+    }
+    const qadc_q3_13_fixed_t unity = 1 << QADC_Q_3_13_SHIFT;
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % num_adc;
+        unsigned i = n % NUM_TICKS;
+        unsigned posn = qadc_pot_ticks_to_position(lut, dir_in[i], ticks_in[i], unity, 0);
+        sink += qadc_pot_post_process(&filter, hysteris_tracker, ch, 1, lut_size, 0, posn);
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+// As bench_pot() but only holding the ticks and direction per conversion, with the LUT lookup, filtering and
+// hysteresis batched at the end of each scan as qadc_pot_batch_flush() does
+static double bench_pot_batch(unsigned lut_size, unsigned depth, unsigned num_adc, qadc_filter_type_t type,
+                              const qadc_pot_lut_t *lut, unsigned conversions){
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, type, depth, lut_size - 1, num_adc, filter_buffer);
+    for(unsigned ch = 0; ch < num_adc; ch++){
+        hysteris_tracker[ch] = 0;
+    }
+    for(unsigned ch = 0; ch < num_adc; ch++){
+        max_scale[ch] = 1 << QADC_Q_3_13_SHIFT;
+    }
+    uint32_t up_mask = 0;
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % num_adc;
+        unsigned i = n % NUM_TICKS;
+        raw_results[ch] = ticks_in[i];
+        up_mask = (up_mask & ~(1 << ch)) | (dir_in[i] << ch);
+        if(ch == num_adc - 1){
+            qadc_pot_ticks_to_position_batch(lut, raw_results, 0xffffffff >> (32 - num_adc), up_mask, max_scale, max_scale, 0, num_adc);
+            qadc_pot_post_process_batch(&filter, hysteris_tracker, raw_results, results, num_adc, 1, lut_size, 0);
+            sink += results[0];
+        }
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+static double bench_rheo(unsigned adc_steps, unsigned depth, unsigned num_adc, qadc_filter_type_t type, unsigned conversions){
+    const unsigned max_disch_ticks = qadc_rheo_calc_max_disch_ticks(47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, type, depth, max_disch_ticks, num_adc, filter_buffer);
+    for(unsigned ch = 0; ch < num_adc; ch++){
+        hysteris_tracker[ch] = 0;
+        max_seen_ticks[ch] = max_disch_ticks;
+        max_scale[ch] = 1 << QADC_Q_3_13_SHIFT;
+    }
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % num_adc;
+        uint16_t ticks = ticks_in[n % NUM_TICKS] % max_disch_ticks;
+        sink += qadc_rheo_post_process(&filter, hysteris_tracker, max_seen_ticks, max_scale, ch, 1,
+                                       1, adc_steps, 0, max_disch_ticks, ticks);
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+static double bench_rheo_batch(unsigned adc_steps, unsigned depth, unsigned num_adc, qadc_filter_type_t type, unsigned conversions){
+    const unsigned max_disch_ticks = qadc_rheo_calc_max_disch_ticks(47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, type, depth, max_disch_ticks, num_adc, filter_buffer);
+    for(unsigned ch = 0; ch < num_adc; ch++){
+        hysteris_tracker[ch] = 0;
+        max_seen_ticks[ch] = max_disch_ticks;
+        max_scale[ch] = 1 << QADC_Q_3_13_SHIFT;
+    }
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % num_adc;
+        raw_results[ch] = ticks_in[n % NUM_TICKS] % max_disch_ticks;
+        if(ch == num_adc - 1){
+            qadc_rheo_post_process_batch(&filter, hysteris_tracker, max_seen_ticks, max_scale, 1,
+                                         1, adc_steps, 0, max_disch_ticks, raw_results, results, num_adc);
+            sink += results[0];
+        }
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+int main(int argc, char *argv[]){
+    unsigned conversions = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    for(unsigned s = 0; s < ARRAY_SIZE(lut_sizes); s++){
+        const unsigned lut_size = lut_sizes[s];
+        qadc_pot_lut_t lut;
+        double gen_us = bench_lut_gen(lut_size, &lut);
+        printf("lut_size: %u lut_gen_us: %.1f\n", lut_size, gen_us);
+
+        // Spread the conversions over the whole tick range in both directions
+        srand(lut_size);
+        uint32_t max_ticks = lut.max_lut_ticks_up > lut.max_lut_ticks_down ? lut.max_lut_ticks_up : lut.max_lut_ticks_down;
+        for(unsigned i = 0; i < NUM_TICKS; i++){
+            ticks_in[i] = rand() % (max_ticks + 1);
+            dir_in[i] = rand() & 1;
+        }
+
+        for(unsigned t = 0; t < ARRAY_SIZE(filter_types); t++){
+            for(unsigned d = 0; d < ARRAY_SIZE(filter_depths); d++){
+                for(unsigned a = 0; a < ARRAY_SIZE(num_adcs); a++){
+                    double pot_ns = bench_pot(lut_size, filter_depths[d], num_adcs[a], filter_types[t], &lut, conversions);
+                    double rheo_ns = bench_rheo(lut_size, filter_depths[d], num_adcs[a], filter_types[t], conversions);
+                    double pot_batch_ns = bench_pot_batch(lut_size, filter_depths[d], num_adcs[a], filter_types[t], &lut, conversions);
+                    double rheo_batch_ns = bench_rheo_batch(lut_size, filter_depths[d], num_adcs[a], filter_types[t], conversions);
+                    printf("lut_size: %u filter: %s filter_depth: %u num_adc: %u pot_ns_per_conv: %.1f rheo_ns_per_conv: %.1f"
+                           " pot_batch_ns_per_conv: %.1f rheo_batch_ns_per_conv: %.1f\n",
+                            lut_size, filter_names[t], filter_depths[d], num_adcs[a], pot_ns, rheo_ns, pot_batch_ns, rheo_batch_ns);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Host micro-benchmark of compile time specialisation (see lib_qadc/src/qadc_static.h). Built twice for one
+// fixed configuration, once against the generic core (qadc_core_benchmark_fixed) and once against a core
+// built with QADC_STATIC_xxx set to the same values (qadc_core_benchmark_static), so the two reports can
+// be compared directly.
+//   qadc_core_benchmark_xxx [conversions]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "qadc_core.h"
+
+// The configuration. CMakeLists.txt sets QADC_STATIC_xxx to match for the specialised build.
+#define BENCH_NUM_ADC           8
+#define BENCH_LUT_SIZE          1024
+#define BENCH_ADC_STEPS         1024
+#define BENCH_FILTER_TYPE       QADC_FILTER_MOVING_AVERAGE
+#define BENCH_FILTER_DEPTH      8
+#define BENCH_R_POT             47000
+#define BENCH_C_F               2200e-12
+#define BENCH_R_SERIES          470
+#define BENCH_V_RAIL            3.3
+#define BENCH_V_THRESH          1.15
+#define NUM_TICKS               4096 // Pre-generated inputs so rand() is not timed
+
+#ifdef QADC_STATIC_NUM_ADC
+#define VARIANT                 "static"
+_Static_assert(QADC_STATIC_NUM_ADC == BENCH_NUM_ADC, "Specialisation does not match the benchmark");
+_Static_assert(QADC_STATIC_FILTER_DEPTH == BENCH_FILTER_DEPTH, "Specialisation does not match the benchmark");
+#else
+#define VARIANT                 "generic"
+#endif
+
+static uint16_t lut_buffer[QADC_POT_LUT_BUFFER_SIZE(BENCH_LUT_SIZE)];
+static uint16_t filter_buffer[QADC_FILTER_STATE_SIZE(BENCH_NUM_ADC, BENCH_FILTER_TYPE, BENCH_FILTER_DEPTH)];
+static uint16_t hysteris_tracker[BENCH_NUM_ADC];
+static uint16_t max_seen_ticks[BENCH_NUM_ADC];
+static qadc_q3_13_fixed_t max_scale[BENCH_NUM_ADC];
+static uint16_t raw_results[BENCH_NUM_ADC];
+static uint16_t results[BENCH_NUM_ADC];
+static uint16_t ticks_in[NUM_TICKS];
+static uint8_t dir_in[NUM_TICKS];
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static double bench_pot(const qadc_pot_lut_t *lut, unsigned conversions){
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, BENCH_FILTER_TYPE, BENCH_FILTER_DEPTH, BENCH_LUT_SIZE - 1, BENCH_NUM_ADC, filter_buffer);
+    for(unsigned ch = 0; ch < BENCH_NUM_ADC; ch++){
+        hysteris_tracker[ch] = 0;
+    }
+    const qadc_q3_13_fixed_t unity = 1 << QADC_Q_3_13_SHIFT;
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % BENCH_NUM_ADC;
+        unsigned i = n % NUM_TICKS;
+        unsigned posn = qadc_pot_ticks_to_position(lut, dir_in[i], ticks_in[i], unity, 0);
+        sink += qadc_pot_post_process(&filter, hysteris_tracker, ch, 1, BENCH_LUT_SIZE, 0, posn);
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+static void rheo_reset(qadc_filter_t *filter, unsigned max_disch_ticks){
+    qadc_filter_init(filter, BENCH_FILTER_TYPE, BENCH_FILTER_DEPTH, max_disch_ticks, BENCH_NUM_ADC, filter_buffer);
+    for(unsigned ch = 0; ch < BENCH_NUM_ADC; ch++){
+        hysteris_tracker[ch] = 0;
+        max_seen_ticks[ch] = max_disch_ticks;
+        max_scale[ch] = 1 << QADC_Q_3_13_SHIFT;
+    }
+}
+
+
+static double bench_rheo(unsigned max_disch_ticks, unsigned conversions){
+    qadc_filter_t filter;
+    rheo_reset(&filter, max_disch_ticks);
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % BENCH_NUM_ADC;
+        uint16_t ticks = ticks_in[n % NUM_TICKS] % max_disch_ticks;
+        sink += qadc_rheo_post_process(&filter, hysteris_tracker, max_seen_ticks, max_scale, ch, 1,
+                                       1, BENCH_ADC_STEPS, 0, max_disch_ticks, ticks);
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+static double bench_rheo_batch(unsigned max_disch_ticks, unsigned conversions){
+    qadc_filter_t filter;
+    rheo_reset(&filter, max_disch_ticks);
+
+    volatile unsigned sink = 0;
+    uint64_t t0 = now_ns();
+    for(unsigned n = 0; n < conversions; n++){
+        unsigned ch = n % BENCH_NUM_ADC;
+        raw_results[ch] = ticks_in[n % NUM_TICKS] % max_disch_ticks;
+        if(ch == BENCH_NUM_ADC - 1){
+            qadc_rheo_post_process_batch(&filter, hysteris_tracker, max_seen_ticks, max_scale, 1,
+                                         1, BENCH_ADC_STEPS, 0, max_disch_ticks, raw_results, results, BENCH_NUM_ADC);
+            sink += results[0];
+        }
+    }
+    (void)sink;
+    return (double)(now_ns() - t0) / conversions;
+}
+
+
+int main(int argc, char *argv[]){
+    unsigned conversions = argc > 1 ? atoi(argv[1]) : 1000000;
+    srand(1);
+
+    qadc_pot_lut_t lut;
+    qadc_pot_lut_gen(&lut, lut_buffer, BENCH_LUT_SIZE, BENCH_R_POT, BENCH_C_F, BENCH_R_SERIES, BENCH_V_RAIL, BENCH_V_THRESH);
+    for(unsigned i = 0; i < NUM_TICKS; i++){
+        dir_in[i] = rand() & 1;
+        uint32_t max_ticks = dir_in[i] ? lut.max_lut_ticks_up : lut.max_lut_ticks_down;
+        ticks_in[i] = rand() % (max_ticks + 1);
+    }
+
+    const unsigned max_disch_ticks = qadc_rheo_calc_max_disch_ticks(BENCH_R_POT, BENCH_C_F, BENCH_R_SERIES, BENCH_V_RAIL, BENCH_V_THRESH);
+#ifdef QADC_STATIC_MAX_DISCH_TICKS
+    if(max_disch_ticks != QADC_STATIC_MAX_DISCH_TICKS){
+        printf("QADC_STATIC_MAX_DISCH_TICKS should be %u\n", max_disch_ticks);
+        return 1;
+    }
+#endif
+
+    printf("variant: %s num_adc: %u lut_size: %u adc_steps: %u filter_depth: %u pot_ns_per_conv: %.1f"
+           " rheo_ns_per_conv: %.1f rheo_batch_ns_per_conv: %.1f\n",
+           VARIANT, BENCH_NUM_ADC, BENCH_LUT_SIZE, BENCH_ADC_STEPS, BENCH_FILTER_DEPTH,
+           bench_pot(&lut, conversions), bench_rheo(max_disch_ticks, conversions), bench_rheo_batch(max_disch_ticks, conversions));
+
+    return 0;
+}
@@ -0,0 +1,617 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Host regression test for the portable QADC core. With no arguments it runs the self checks and
+// prints PASS/FAIL. With --dump-lut it writes the up then down LUTs as raw uint16 so that
+// test_qadc_host_core.py can compare them against design/qadc_model.py.
+//   qadc_core_test --dump-lut <lut_size> <cap_pf> <r_pot_ohms> <r_series_ohms> <v_rail> <v_thresh> <file>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "qadc_core.h"
+
+#define MAX_LUT_SIZE    2048
+#define MAX_ADC         8
+#define MAX_DEPTH       64
+
+static uint16_t lut_up[MAX_LUT_SIZE];
+static uint16_t lut_down[MAX_LUT_SIZE];
+static uint16_t lut_compact[QADC_POT_LUT_BUFFER_SIZE(MAX_LUT_SIZE)];
+static uint16_t filter_buffer[QADC_FILTER_STATE_SIZE(MAX_ADC, QADC_FILTER_MOVING_AVERAGE, MAX_DEPTH)];
+static uint16_t filter_buffer_batch[QADC_FILTER_STATE_SIZE(MAX_ADC, QADC_FILTER_MOVING_AVERAGE, MAX_DEPTH)];
+
+static unsigned failures = 0;
+
+#define CHECK(cond, ...) do{ if(!(cond)){ printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; } }while(0)
+
+static void gen_default_lut(unsigned lut_size, uint32_t *max_up, uint32_t *max_down){
+    gen_lookup_pot(lut_up, lut_down, lut_size, 47000, 2200e-12, 470, 3.3, 1.15, max_up, max_down);
+}
+
+
+// The indexed search must match the reference scan everywhere a difference could show
+static void test_lut_search(void){
+    static const unsigned lut_sizes[] = {64, 256, 1024, 2048};
+    for(unsigned s = 0; s < sizeof(lut_sizes) / sizeof(lut_sizes[0]); s++){
+        unsigned n = lut_sizes[s];
+        uint32_t max_up = 0, max_down = 0;
+        gen_default_lut(n, &max_up, &max_down);
+        CHECK(max_up < 65536 && max_down < 65536, "lut_size %u exceeds port timer", n);
+
+        qadc_pot_lut_index_t index;
+        qadc_pot_lut_index_build(&index, lut_up, lut_down, n);
+        CHECK(index.use_linear_search == 0, "lut_size %u fell back to linear search", n);
+
+        for(int is_up = 0; is_up < 2; is_up++){
+            const uint16_t *lut = is_up ? lut_up : lut_down;
+            for(unsigned i = 0; i < n; i++){
+                for(int offset = -1; offset <= 1; offset++){
+                    uint16_t ticks = (uint16_t)(lut[i] + offset);
+                    unsigned expected = qadc_pot_lut_search_linear(lut_up, lut_down, n, is_up, ticks);
+                    unsigned actual = qadc_pot_lut_search(&index, lut_up, lut_down, n, is_up, ticks);
+                    CHECK(expected == actual, "lut_size %u is_up %d ticks %u expected %u actual %u", n, is_up, ticks, expected, actual);
+                }
+            }
+        }
+    }
+}
+
+
+// The compact table must hold exactly the populated entries of the full tables and search identically
+static void test_lut_compact(void){
+    static const unsigned lut_sizes[] = {64, 256, 1024, 2048};
+    for(unsigned s = 0; s < sizeof(lut_sizes) / sizeof(lut_sizes[0]); s++){
+        unsigned n = lut_sizes[s];
+        uint32_t max_up = 0, max_down = 0;
+        gen_default_lut(n, &max_up, &max_down);
+        qadc_pot_lut_index_t index;
+        qadc_pot_lut_index_build(&index, lut_up, lut_down, n);
+
+        qadc_pot_lut_t lut;
+        qadc_pot_lut_gen(&lut, lut_compact, n, 47000, 2200e-12, 470, 3.3, 1.15);
+        CHECK(lut.max_lut_ticks_up == max_up && lut.max_lut_ticks_down == max_down, "lut_size %u max ticks differ", n);
+        CHECK(lut.index.use_linear_search == 0, "lut_size %u compact fell back to linear search", n);
+
+        for(unsigned i = 0; i < n; i++){
+            uint16_t up = i >= lut.split_idx ? lut.ticks[i] : 0;
+            uint16_t down = i < lut.split_idx ? lut.ticks[i] : 0;
+            CHECK(up == lut_up[i] && down == lut_down[i], "lut_size %u idx %u split %u compact entry differs", n, i, lut.split_idx);
+        }
+
+        // Every reachable tick value, in both directions
+        uint32_t max_ticks = max_up > max_down ? max_up : max_down;
+        for(int is_up = 0; is_up < 2; is_up++){
+            for(uint32_t ticks = 0; ticks <= max_ticks + 1; ticks++){
+                unsigned expected = qadc_pot_lut_search(&index, lut_up, lut_down, n, is_up, ticks);
+                unsigned actual = qadc_pot_lut_search_compact(&lut.index, lut.ticks, lut.split_idx, n, is_up, ticks);
+                CHECK(expected == actual, "lut_size %u is_up %d ticks %u expected %u compact %u", n, is_up, ticks, expected, actual);
+                if((ticks & 0xff) == 0){ // The O(n) scan is slow so sample it
+                    unsigned linear = qadc_pot_lut_search_compact_linear(lut.ticks, lut.split_idx, n, is_up, ticks);
+                    CHECK(expected == linear, "lut_size %u is_up %d ticks %u expected %u compact linear %u", n, is_up, ticks, expected, linear);
+                }
+            }
+        }
+    }
+}
+
+
+// Transition times are proportional to C so a rescaled table must match one generated with a larger capacitor
+static void test_lut_rescale(void){
+    static uint16_t lut_rescaled[QADC_POT_LUT_BUFFER_SIZE(MAX_LUT_SIZE)];
+    static uint16_t lut_bigger_cap[QADC_POT_LUT_BUFFER_SIZE(MAX_LUT_SIZE)];
+    const unsigned n = 1024;
+    qadc_pot_lut_t ref, expected;
+    qadc_pot_lut_gen(&ref, lut_compact, n, 47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_pot_lut_gen(&expected, lut_bigger_cap, n, 47000, 2200e-12 * 1.25, 470, 3.3, 1.15);
+
+    const uint32_t unity = 1 << QADC_POT_CAL_SCALE_SHIFT;
+    CHECK(qadc_pot_lut_cal_scale(0, ref.max_lut_ticks_up) == unity, "nothing observed should be unity");
+    qadc_pot_lut_rescale(lut_rescaled, ref.ticks, 0, n, ref.split_idx, unity, unity);
+    CHECK(memcmp(lut_rescaled, ref.ticks, n * sizeof(uint16_t)) == 0, "unity rescale changed the table");
+
+    uint32_t scale_up = qadc_pot_lut_cal_scale(expected.max_lut_ticks_up, ref.max_lut_ticks_up);
+    uint32_t scale_down = qadc_pot_lut_cal_scale(expected.max_lut_ticks_down, ref.max_lut_ticks_down);
+    // In chunks, as the task does
+    for(unsigned start = 0; start < n; start += QADC_POT_CAL_CHUNK){
+        unsigned end = start + QADC_POT_CAL_CHUNK < n ? start + QADC_POT_CAL_CHUNK : n;
+        qadc_pot_lut_rescale(lut_rescaled, ref.ticks, start, end, ref.split_idx, scale_down, scale_up);
+    }
+    for(unsigned i = 0; i < n; i++){
+        int diff = (int)lut_rescaled[i] - (int)expected.ticks[i];
+        CHECK(diff >= -2 && diff <= 2, "idx %u rescaled %u expected %u", i, lut_rescaled[i], expected.ticks[i]);
+        CHECK((lut_rescaled[i] == 0) == (ref.ticks[i] == 0), "idx %u reachability changed", i);
+    }
+
+    qadc_pot_lut_index_t index;
+    qadc_pot_lut_index_build_compact(&index, lut_rescaled, ref.split_idx, n);
+    CHECK(index.use_linear_search == 0, "rescaled table fell back to linear search");
+
+    CHECK(qadc_pot_lut_rescale_ticks(60000, 2 * unity) == UINT16_MAX, "rescale should saturate");
+    CHECK(qadc_pot_lut_rescale_ticks(1, unity / 4) == 1, "reachable entry rounded to zero");
+
+    const qadc_q3_13_fixed_t rheo_unity = 1 << QADC_Q_3_13_SHIFT;
+    CHECK(qadc_rheo_cal_scale(1000, 500) == 2 * rheo_unity, "rheo cal scale %u", qadc_rheo_cal_scale(1000, 500));
+    CHECK(qadc_rheo_cal_scale(1000, 0) == rheo_unity, "rheo cal with nothing seen");
+    CHECK(qadc_rheo_cal_scale(60000, 1) == UINT16_MAX, "rheo cal scale should saturate");
+}
+
+
+// Nominal scale must not move the ticks so the result matches a direct LUT search
+static void test_ticks_to_position(void){
+    const unsigned n = 1024;
+    uint32_t max_up = 0, max_down = 0;
+    gen_default_lut(n, &max_up, &max_down);
+    qadc_pot_lut_index_t index;
+    qadc_pot_lut_index_build(&index, lut_up, lut_down, n);
+    qadc_pot_lut_t lut;
+    qadc_pot_lut_gen(&lut, lut_compact, n, 47000, 2200e-12, 470, 3.3, 1.15);
+
+    const qadc_q3_13_fixed_t unity = 1 << QADC_Q_3_13_SHIFT;
+    CHECK(qadc_pot_max_ticks_expected(max_up, unity) == (int32_t)max_up, "unity scale changed max ticks");
+    CHECK(qadc_pot_auto_scale(unity, 1200, 1000) == (unity * 12) / 10, "auto scale stretch");
+
+    for(unsigned i = 0; i < n; i++){
+        int is_up = lut_up[i] != 0;
+        uint16_t ticks = is_up ? lut_up[i] : lut_down[i];
+        if(ticks == 0 || ticks > 60000){
+            continue; // Unreachable entries at the ends
+        }
+        unsigned posn = qadc_pot_ticks_to_position(&lut, is_up, ticks + 1, unity, 0);
+        unsigned direct = qadc_pot_lut_search(&index, lut_up, lut_down, n, is_up, ticks + 1);
+        CHECK(posn == direct, "idx %u ticks_to_position %u search %u", i, posn, direct);
+    }
+}
+
+
+// Interpolating a coarse LUT must track the position read from a much finer one more closely than its index does
+static void test_interpolation(void){
+    static uint16_t lut_fine[QADC_POT_LUT_BUFFER_SIZE(MAX_LUT_SIZE)];
+    const unsigned n_coarse = 128;
+    const unsigned n_fine = MAX_LUT_SIZE;
+    const unsigned frac_bits = 6;
+    const qadc_q3_13_fixed_t unity = 1 << QADC_Q_3_13_SHIFT;
+    qadc_pot_lut_t coarse, fine;
+    qadc_pot_lut_gen(&coarse, lut_compact, n_coarse, 47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_pot_lut_gen(&fine, lut_fine, n_fine, 47000, 2200e-12, 470, 3.3, 1.15);
+
+    double err_int = 0, err_frac = 0, max_err_frac = 0;
+    unsigned count = 0;
+    for(unsigned k = 0; k < n_fine; k++){
+        int is_up = k >= fine.split_idx;
+        uint16_t ticks = lut_fine[k];
+        if(ticks == 0 || ticks > 60000){
+            continue;
+        }
+        double expected = (double)k * (n_coarse - 1) / (n_fine - 1);
+        unsigned posn_int = qadc_pot_ticks_to_position(&coarse, is_up, ticks, unity, 0);
+        uint32_t posn_frac = qadc_pot_ticks_to_position(&coarse, is_up, ticks, unity, frac_bits);
+        CHECK((posn_frac >> frac_bits) + 1 >= posn_int && (posn_frac >> frac_bits) <= posn_int + 1,
+              "k %u frac %u far from index %u", k, posn_frac, posn_int);
+        double e_frac = (double)posn_frac / (1 << frac_bits) - expected;
+        double e_int = (double)posn_int - expected;
+        e_frac = e_frac < 0 ? -e_frac : e_frac;
+        e_int = e_int < 0 ? -e_int : e_int;
+        // Either side of the threshold and at the end stops the coarse table has no bracketing neighbour
+        int has_neighbours = posn_int > 0 && posn_int + 1 < n_coarse && posn_int != coarse.split_idx && posn_int + 1 != coarse.split_idx &&
+                             lut_compact[posn_int - 1] != 0 && lut_compact[posn_int + 1] != 0;
+        if(has_neighbours){
+            err_int += e_int;
+            err_frac += e_frac;
+            max_err_frac = e_frac > max_err_frac ? e_frac : max_err_frac;
+            count++;
+        }
+    }
+    err_int /= count;
+    err_frac /= count;
+    CHECK(count > n_fine / 2, "only %u comparable points", count);
+    CHECK(err_frac < err_int / 4, "mean error interpolated %.3f integer %.3f", err_frac, err_int);
+    CHECK(max_err_frac < 0.5, "max interpolated error %.3f", max_err_frac);
+
+    // Sweeping ticks across one step of the table must move the position smoothly between the two entries
+    unsigned i = coarse.split_idx / 2;
+    uint32_t last = (uint32_t)i << frac_bits;
+    for(uint16_t ticks = lut_compact[i] + 1; ticks <= lut_compact[i + 1]; ticks++){
+        uint32_t posn = qadc_pot_ticks_to_position(&coarse, 0, ticks, unity, frac_bits);
+        CHECK(posn >= last && posn <= (uint32_t)(i + 1) << frac_bits, "ticks %u posn %u after %u", ticks, posn, last);
+        last = posn;
+    }
+    CHECK(last == (uint32_t)(i + 1) << frac_bits, "sweep ended at %u", last);
+
+    // Rheo with fractional bits is the same quantisation, finer
+    unsigned max_disch_ticks = qadc_rheo_calc_max_disch_ticks(47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, QADC_FILTER_IIR, 1, max_disch_ticks, 1, filter_buffer);
+    uint16_t hysteris_tracker = 0;
+    uint16_t max_seen_ticks = max_disch_ticks;
+    qadc_q3_13_fixed_t max_scale = unity;
+    uint16_t ticks = max_disch_ticks * 2 / 7;
+    uint16_t result = qadc_rheo_post_process(&filter, &hysteris_tracker, &max_seen_ticks, &max_scale, 0, 0,
+                                             0, 256, frac_bits, max_disch_ticks, ticks);
+    CHECK(result == (255u << frac_bits) * ticks / max_disch_ticks && result >> frac_bits == 255 * ticks / max_disch_ticks,
+          "rheo frac result %u", result);
+}
+
+
+// The running sum must always equal an average recomputed from scratch
+static void test_moving_average(void){
+    const unsigned depth = 32;
+    const unsigned num_adc = 4;
+    qadc_filter_t filter;
+    uint16_t *end = qadc_filter_init(&filter, QADC_FILTER_MOVING_AVERAGE, depth, 1023, num_adc, filter_buffer);
+    CHECK(end == filter_buffer + QADC_FILTER_STATE_SIZE(num_adc, QADC_FILTER_MOVING_AVERAGE, depth), "filter state size");
+
+    uint16_t history[MAX_ADC][MAX_DEPTH] = {{0}};
+    srand(1);
+    for(unsigned n = 0; n < 10000; n++){
+        unsigned ch = n % num_adc;
+        uint16_t sample = rand() % 1024;
+        history[ch][(n / num_adc) % depth] = sample;
+        uint32_t sum = 0;
+        for(unsigned i = 0; i < depth; i++){
+            sum += history[ch][i];
+        }
+        uint16_t filtered = qadc_filter_apply(&filter, ch, sample);
+        CHECK(filtered == sum / depth, "n %u ch %u got %u expected %u", n, ch, filtered, sum / depth);
+    }
+}
+
+
+// Both IIR types must settle exactly on a stationary input from either side
+static void test_iir(void){
+    const qadc_filter_type_t types[] = {QADC_FILTER_IIR, QADC_FILTER_SLEW_ADAPTIVE};
+    for(unsigned t = 0; t < 2; t++){
+        qadc_filter_t filter;
+        qadc_filter_init(&filter, types[t], 32, 1023, 1, filter_buffer);
+        const uint16_t targets[] = {1023, 0, 517, 1, 1022};
+        for(unsigned i = 0; i < sizeof(targets) / sizeof(targets[0]); i++){
+            uint16_t filtered = 0;
+            for(unsigned n = 0; n < 2000; n++){
+                filtered = qadc_filter_apply(&filter, 0, targets[i]);
+            }
+            CHECK(filtered == targets[i], "type %u target %u settled at %u", types[t], targets[i], filtered);
+        }
+    }
+}
+
+
+static void test_hysteresis(void){
+    uint16_t tracker = 100;
+    CHECK(qadc_hysteresis(101, &tracker, 1, 1023) == 100, "inside band");
+    CHECK(qadc_hysteresis(102, &tracker, 1, 1023) == 102, "above band");
+    CHECK(qadc_hysteresis(100, &tracker, 1, 1023) == 100, "below band");
+    CHECK(qadc_hysteresis(1023, &tracker, 100, 1023) == 1023, "full scale always passes");
+    CHECK(qadc_hysteresis(0, &tracker, 2000, 1023) == 0, "zero always passes");
+}
+
+
+// Rheo output must cover zero to full scale and never decrease with discharge time
+static void test_rheo(void){
+    unsigned max_disch_ticks = qadc_rheo_calc_max_disch_ticks(47000, 2200e-12, 470, 3.3, 1.15);
+    CHECK(max_disch_ticks > 0 && max_disch_ticks * 2 < 65536, "max_disch_ticks %u", max_disch_ticks);
+
+    const size_t adc_steps = 256;
+    qadc_filter_t filter;
+    qadc_filter_init(&filter, QADC_FILTER_IIR, 1, max_disch_ticks, 1, filter_buffer); // Depth 1 is a pass through
+    uint16_t hysteris_tracker = 0;
+    uint16_t max_seen_ticks = max_disch_ticks;
+    qadc_q3_13_fixed_t max_scale = 1 << QADC_Q_3_13_SHIFT;
+
+    uint16_t last = 0;
+    for(unsigned ticks = 0; ticks <= max_disch_ticks; ticks++){
+        uint16_t result = qadc_rheo_post_process(&filter, &hysteris_tracker, &max_seen_ticks, &max_scale, 0, 1,
+                                                 0, adc_steps, 0, max_disch_ticks, ticks);
+        CHECK(result >= last, "ticks %u result %u after %u", ticks, result, last);
+        last = result;
+    }
+    CHECK(last == adc_steps - 1, "full scale %u", last);
+
+    // A longer discharge than expected with auto_scale set becomes the new full scale (within Q3.13 truncation)
+    uint16_t result = qadc_rheo_post_process(&filter, &hysteris_tracker, &max_seen_ticks, &max_scale, 0, 1,
+                                             0, adc_steps, 0, max_disch_ticks, max_disch_ticks * 5 / 4);
+    CHECK(result >= adc_steps - 2 && max_scale < (1 << QADC_Q_3_13_SHIFT), "auto scale result %u scale %u", result, max_scale);
+}
+
+
+// Post processing a whole scan at once must match processing each channel as it is converted
+static void test_batch_post_process(void){
+    const qadc_filter_type_t types[] = {QADC_FILTER_MOVING_AVERAGE, QADC_FILTER_IIR, QADC_FILTER_SLEW_ADAPTIVE};
+    const unsigned depths[] = {1, 8};
+    const unsigned num_adc = 5;
+    const size_t lut_size = 1024;
+    const uint16_t max_disch_ticks = qadc_rheo_calc_max_disch_ticks(47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_pot_lut_t lut;
+    qadc_pot_lut_gen(&lut, lut_compact, lut_size, 47000, 2200e-12, 470, 3.3, 1.15);
+    qadc_q3_13_fixed_t scale_up[MAX_ADC], scale_down[MAX_ADC];
+    for(unsigned i = 0; i < num_adc; i++){
+        scale_up[i] = (1 << QADC_Q_3_13_SHIFT) + i * 300;
+        scale_down[i] = (1 << QADC_Q_3_13_SHIFT) - i * 200;
+    }
+
+    // Ticks converted at the end of the scan, as qadc_pot_batch_flush() does, including channels which already
+    // hold a position because they overshot
+    srand(99);
+    for(unsigned scan = 0; scan < 2000; scan++){
+        uint16_t values[MAX_ADC], expected[MAX_ADC];
+        uint32_t convert_mask = 0, up_mask = 0;
+        for(unsigned i = 0; i < num_adc; i++){
+            int is_up = rand() & 1;
+            uint32_t max_ticks = is_up ? lut.max_lut_ticks_up : lut.max_lut_ticks_down;
+            values[i] = rand() % (max_ticks * 2 + 1);
+            up_mask |= is_up << i;
+            if(rand() % 8){
+                convert_mask |= 1 << i;
+                expected[i] = qadc_pot_ticks_to_position(&lut, is_up, values[i], is_up ? scale_up[i] : scale_down[i], 2);
+            } else {
+                expected[i] = values[i];
+            }
+        }
+        qadc_pot_ticks_to_position_batch(&lut, values, convert_mask, up_mask, scale_up, scale_down, 2, num_adc);
+        CHECK(memcmp(values, expected, num_adc * sizeof(uint16_t)) == 0, "ticks to position scan %u", scan);
+    }
+
+    for(unsigned t = 0; t < 3; t++){
+        for(unsigned d = 0; d < 2; d++){
+            qadc_filter_t filter, filter_batch;
+            qadc_filter_init(&filter, types[t], depths[d], lut_size - 1, num_adc, filter_buffer);
+            qadc_filter_init(&filter_batch, types[t], depths[d], lut_size - 1, num_adc, filter_buffer_batch);
+            uint16_t tracker[MAX_ADC] = {0}, tracker_batch[MAX_ADC] = {0};
+            uint16_t raw[MAX_ADC], results[MAX_ADC], results_batch[MAX_ADC];
+
+            srand(t * 2 + d);
+            for(unsigned scan = 0; scan < 500; scan++){
+                for(unsigned i = 0; i < num_adc; i++){
+                    raw[i] = scan % 50 < 25 ? rand() % lut_size : (i * 97) % lut_size; // Noisy then still
+                    results[i] = qadc_pot_post_process(&filter, tracker, i, 2, lut_size, 0, raw[i]);
+                }
+                qadc_pot_post_process_batch(&filter_batch, tracker_batch, raw, results_batch, num_adc, 2, lut_size, 0);
+                CHECK(memcmp(results, results_batch, num_adc * sizeof(uint16_t)) == 0, "pot type %u depth %u scan %u", types[t], depths[d], scan);
+            }
+
+            // Rheo including the auto_scale tracking, with discharges beyond the expected maximum
+            qadc_filter_init(&filter, types[t], depths[d], max_disch_ticks, num_adc, filter_buffer);
+            qadc_filter_init(&filter_batch, types[t], depths[d], max_disch_ticks, num_adc, filter_buffer_batch);
+            uint16_t max_seen[MAX_ADC] = {0}, max_seen_batch[MAX_ADC] = {0};
+            qadc_q3_13_fixed_t scale[MAX_ADC], scale_batch[MAX_ADC];
+            for(unsigned i = 0; i < num_adc; i++){
+                tracker[i] = tracker_batch[i] = 0;
+                scale[i] = scale_batch[i] = 1 << QADC_Q_3_13_SHIFT;
+            }
+            for(unsigned scan = 0; scan < 500; scan++){
+                int auto_scale = scan >= 250;
+                for(unsigned i = 0; i < num_adc; i++){
+                    raw[i] = rand() % (max_disch_ticks * 5 / 4);
+                    results[i] = qadc_rheo_post_process(&filter, tracker, max_seen, scale, i, auto_scale,
+                                                        1, 256, 2, max_disch_ticks, raw[i]);
+                }
+                qadc_rheo_post_process_batch(&filter_batch, tracker_batch, max_seen_batch, scale_batch, auto_scale,
+                                             1, 256, 2, max_disch_ticks, raw, results_batch, num_adc);
+                CHECK(memcmp(results, results_batch, num_adc * sizeof(uint16_t)) == 0 &&
+                      memcmp(scale, scale_batch, num_adc * sizeof(qadc_q3_13_fixed_t)) == 0,
+                      "rheo type %u depth %u scan %u", types[t], depths[d], scan);
+            }
+        }
+    }
+}
+
+
+static void test_mailbox(void){
+    qadc_mailbox_t mailbox;
+    qadc_mailbox_snapshot_t snapshot = {0};
+    uint16_t results[4] = {10, 20, 30, 40};
+    qadc_mailbox_init(&mailbox, 4);
+
+    CHECK(qadc_mailbox_read(&mailbox, &snapshot) == 0 && snapshot.new_data_mask == 0, "data before first publish");
+
+    for(unsigned ch = 0; ch < 4; ch++){
+        qadc_mailbox_stamp(&mailbox, ch, 1000 + ch);
+    }
+    qadc_mailbox_publish(&mailbox, results);
+    CHECK(qadc_mailbox_read(&mailbox, &snapshot) == 1, "first publish not seen");
+    CHECK(snapshot.new_data_mask == 0xf, "first read mask 0x%x", snapshot.new_data_mask);
+    CHECK(snapshot.results[2] == 30 && snapshot.timestamps[3] == 1003, "first read contents");
+
+    CHECK(qadc_mailbox_read(&mailbox, &snapshot) == 0 && snapshot.new_data_mask == 0, "re-read reported new data");
+
+    // Only changed channels are flagged, including changes from scans the reader missed
+    results[1] = 21;
+    qadc_mailbox_publish(&mailbox, results);
+    qadc_mailbox_publish(&mailbox, results);
+    results[3] = 41;
+    qadc_mailbox_publish(&mailbox, results);
+    CHECK(qadc_mailbox_read(&mailbox, &snapshot) == 1 && snapshot.new_data_mask == 0xa, "changed mask 0x%x", snapshot.new_data_mask);
+    qadc_mailbox_publish(&mailbox, results);
+    CHECK(qadc_mailbox_read(&mailbox, &snapshot) == 1 && snapshot.new_data_mask == 0, "unchanged scan mask 0x%x", snapshot.new_data_mask);
+}
+
+
+// A writer publishes scans where every channel holds the scan number. Any reader copy mixing two scans is torn.
+#define MAILBOX_STRESS_SCANS    200000
+static void test_adaptive_sched(void){
+    // Settle time is symmetric, largest mid travel and zero at the ends
+    const uint32_t rc_ticks = 10340; // 2200pF * 47k
+    CHECK(qadc_pot_settle_ticks(rc_ticks, 0, 1024) == 0 && qadc_pot_settle_ticks(rc_ticks, 1023, 1024) == 0, "end settle");
+    CHECK(qadc_pot_settle_ticks(rc_ticks, 100, 1024) == qadc_pot_settle_ticks(rc_ticks, 923, 1024), "settle not symmetric");
+    uint32_t mid = qadc_pot_settle_ticks(rc_ticks, 511, 1024);
+    CHECK(mid > qadc_pot_settle_ticks(rc_ticks, 100, 1024) && mid <= 3 * rc_ticks / 4, "mid settle %u", mid);
+
+    qadc_adaptive_sched_t sched;
+    const uint32_t idle_interval = 100000;
+    uint32_t now = 0xfffff000; // Check the timer wrapping
+    qadc_adaptive_init(&sched, 3, idle_interval, now);
+
+    // Everything due so plain round robin, starting as soon as allowed
+    uint32_t start = 0;
+    for(unsigned i = 0; i < 6; i++){
+        unsigned idx = qadc_adaptive_next(&sched, now, &start);
+        CHECK(idx == i % 3 && start == now, "round robin step %u idx %u", i, idx);
+        qadc_adaptive_result(&sched, idx, 500 + idx, now);
+        now += 10;
+    }
+
+    // Hold channel 1 still until it goes idle while the others keep moving
+    for(unsigned i = 0; i < 3 * QADC_ADAPTIVE_IDLE_CONVERSIONS; i++){
+        unsigned idx = qadc_adaptive_next(&sched, now, &start);
+        qadc_adaptive_result(&sched, idx, idx == 1 ? 501 : i, now);
+        now += 10;
+    }
+    unsigned converted_1 = 0;
+    for(unsigned i = 0; i < 100; i++){
+        unsigned idx = qadc_adaptive_next(&sched, now, &start);
+        CHECK(start == now, "active channel held off");
+        converted_1 += idx == 1;
+        qadc_adaptive_result(&sched, idx, idx == 1 ? 501 : i, now);
+        now += 10;
+    }
+    CHECK(converted_1 == 0, "idle channel converted %u times within idle interval", converted_1);
+
+    // Once due it is converted again and any change makes it active
+    now += idle_interval;
+    unsigned idx = qadc_adaptive_next(&sched, now, &start);
+    while(idx != 1){
+        qadc_adaptive_result(&sched, idx, now & 0xff, now);
+        idx = qadc_adaptive_next(&sched, now, &start);
+    }
+    qadc_adaptive_result(&sched, 1, 600, now);
+    CHECK(sched.next_due[1] == now, "changed channel not active");
+
+    // With everything idle the task waits for the soonest due channel
+    qadc_adaptive_init(&sched, 2, idle_interval, now);
+    for(unsigned i = 0; i < 2 * (QADC_ADAPTIVE_IDLE_CONVERSIONS + 1); i++){
+        idx = qadc_adaptive_next(&sched, now, &start);
+        qadc_adaptive_result(&sched, idx, 0, now);
+        now += 10;
+    }
+    idx = qadc_adaptive_next(&sched, now, &start);
+    CHECK(start == sched.next_due[idx] && (int32_t)(start - now) > 0 && (int32_t)(start - now) <= idle_interval,
+          "all idle wait %d", (int32_t)(start - now));
+}
+
+
+static void test_stats(void){
+    qadc_stats_t stats;
+    qadc_stats_init(&stats, QADC_STATS_MAX_CH + 1, 1600);
+
+    qadc_stats_conversion(&stats, 0, 1, 50);    // Bin 0
+    qadc_stats_conversion(&stats, 0, 1, 1599);  // Bin 15
+    qadc_stats_conversion(&stats, 0, 1, 5000);  // Beyond full scale so top bin
+    qadc_stats_conversion(&stats, 0, 0, 800);   // Bin 8 down
+    qadc_stats_conversion(&stats, QADC_STATS_MAX_CH, 0, 100); // Histogram only
+    CHECK(stats.conversions[0] == 4, "conversions %u", stats.conversions[0]);
+    CHECK(stats.histogram[1][0] == 1 && stats.histogram[1][15] == 2 && stats.histogram[0][8] == 1 && stats.histogram[0][1] == 1,
+          "histogram");
+    CHECK(stats.min_ticks[0][1] == 50 && stats.max_ticks[0][1] == 5000, "up min %u max %u", stats.min_ticks[0][1], stats.max_ticks[0][1]);
+    CHECK(stats.min_ticks[0][0] == 800 && stats.max_ticks[0][0] == 800, "down min %u max %u", stats.min_ticks[0][0], stats.max_ticks[0][0]);
+    CHECK(stats.min_ticks[1][0] == UINT16_MAX && stats.max_ticks[1][0] == 0, "unused channel touched");
+
+    qadc_stats_overshoot(&stats, 2, 0);
+    qadc_stats_overshoot(&stats, 2, 1);
+    qadc_stats_overshoot(&stats, 2, 1);
+    qadc_stats_overshoot(&stats, QADC_STATS_MAX_CH, 1);
+    CHECK(stats.soft_overshoots[2] == 1 && stats.hard_overshoots[2] == 2, "overshoots");
+
+    qadc_stats_proc_time(&stats, 300);
+    qadc_stats_proc_time(&stats, 200);
+    CHECK(stats.max_proc_ticks == 300, "max proc %u", stats.max_proc_ticks);
+
+    qadc_stats_slack(&stats, 5000);
+    qadc_stats_slack(&stats, 1200);
+    CHECK(stats.min_slack_ticks == 1200 && stats.missed_periods == 0, "slack %d", stats.min_slack_ticks);
+    qadc_stats_slack(&stats, -10);
+    CHECK(stats.min_slack_ticks == -10 && stats.missed_periods == 1, "missed period");
+}
+
+
+static qadc_mailbox_t stress_mailbox;
+
+static void *mailbox_writer(void *arg){
+    uint16_t results[QADC_MAILBOX_MAX_CH];
+    for(unsigned scan = 1; scan <= MAILBOX_STRESS_SCANS; scan++){
+        for(unsigned ch = 0; ch < QADC_MAILBOX_MAX_CH; ch++){
+            results[ch] = (uint16_t)scan;
+            qadc_mailbox_stamp(&stress_mailbox, ch, scan);
+        }
+        qadc_mailbox_publish(&stress_mailbox, results);
+    }
+    return NULL;
+}
+
+static void test_mailbox_threaded(void){
+    qadc_mailbox_init(&stress_mailbox, QADC_MAILBOX_MAX_CH);
+    pthread_t writer;
+    pthread_create(&writer, NULL, mailbox_writer, NULL);
+
+    qadc_mailbox_snapshot_t snapshot = {0};
+    unsigned torn = 0, reads = 0;
+    do{
+        if(qadc_mailbox_read(&stress_mailbox, &snapshot)){
+            reads++;
+            for(unsigned ch = 1; ch < QADC_MAILBOX_MAX_CH; ch++){
+                if(snapshot.results[ch] != snapshot.results[0] || snapshot.timestamps[ch] != snapshot.timestamps[0]){
+                    torn++;
+                    break;
+                }
+            }
+        }
+    }while(snapshot.timestamps[0] != MAILBOX_STRESS_SCANS);
+
+    pthread_join(writer, NULL);
+    CHECK(torn == 0, "%u torn reads out of %u", torn, reads);
+}
+
+
+static int dump_lut(int argc, char *argv[]){
+    if(argc != 9){
+        printf("usage: %s --dump-lut <lut_size> <cap_pf> <r_pot_ohms> <r_series_ohms> <v_rail> <v_thresh> <file>\n", argv[0]);
+        return 1;
+    }
+    unsigned lut_size = atoi(argv[2]);
+    if(lut_size > MAX_LUT_SIZE){
+        printf("lut_size %u too large\n", lut_size);
+        return 1;
+    }
+    uint32_t max_up = 0, max_down = 0;
+    gen_lookup_pot(lut_up, lut_down, lut_size, atof(argv[4]), atof(argv[3]) * 1e-12, atof(argv[5]), atof(argv[6]), atof(argv[7]), &max_up, &max_down);
+
+    FILE *fp = fopen(argv[8], "wb");
+    if(!fp){
+        printf("cannot open %s\n", argv[8]);
+        return 1;
+    }
+    fwrite(lut_up, sizeof(uint16_t), lut_size, fp);
+    fwrite(lut_down, sizeof(uint16_t), lut_size, fp);
+    fclose(fp);
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[]){
+    if(argc > 1 && strcmp(argv[1], "--dump-lut") == 0){
+        return dump_lut(argc, argv);
+    }
+
+    test_lut_search();
+    test_lut_compact();
+    test_lut_rescale();
+    test_ticks_to_position();
+    test_interpolation();
+    test_moving_average();
+    test_iir();
+    test_hysteresis();
+    test_rheo();
+    test_batch_post_process();
+    test_mailbox();
+    test_mailbox_threaded();
+    test_adaptive_sched();
+    test_stats();
+
+    if(failures){
+        printf("FAIL: %u checks failed\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
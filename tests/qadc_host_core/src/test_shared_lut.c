@@ -0,0 +1,55 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Checks the const LUT emitted by tools/qadc_pot_lut_gen matches the one generated at runtime for the
+// same components, including the search index.
+
+#include <stdio.h>
+
+#include "qadc_core.h"
+#include "test_shared_lut.h"
+
+static uint16_t lut_buffer[QADC_POT_LUT_BUFFER_SIZE(TEST_SHARED_LUT_LUT_SIZE)];
+
+static int runs_equal(const qadc_pot_lut_run_t *a, const qadc_pot_lut_run_t *b, unsigned num_runs){
+    for(unsigned r = 0; r < num_runs; r++){
+        if(a[r].start != b[r].start || a[r].end != b[r].end || a[r].is_rising != b[r].is_rising){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(void){
+    qadc_pot_lut_t lut;
+    qadc_pot_lut_gen(&lut, lut_buffer, TEST_SHARED_LUT_LUT_SIZE, 47000, 2200 * 1e-12, 470, 3.3, 1.15);
+
+    unsigned failures = 0;
+    for(unsigned i = 0; i < TEST_SHARED_LUT_LUT_SIZE; i++){
+        if(lut.ticks[i] != test_shared_lut.ticks[i]){
+            printf("FAIL: entry %u differs\n", i);
+            failures++;
+        }
+    }
+    if(lut.lut_size != test_shared_lut.lut_size || lut.split_idx != test_shared_lut.split_idx ||
+       lut.max_lut_ticks_up != test_shared_lut.max_lut_ticks_up ||
+       lut.max_lut_ticks_down != test_shared_lut.max_lut_ticks_down ||
+       lut.crossover_idx != test_shared_lut.crossover_idx){
+        printf("FAIL: descriptor differs\n");
+        failures++;
+    }
+    const qadc_pot_lut_index_t *a = &lut.index;
+    const qadc_pot_lut_index_t *b = &test_shared_lut.index;
+    if(a->num_up_runs != b->num_up_runs || a->num_down_runs != b->num_down_runs || a->use_linear_search != b->use_linear_search ||
+       !runs_equal(a->up_runs, b->up_runs, a->num_up_runs) || !runs_equal(a->down_runs, b->down_runs, a->num_down_runs)){
+        printf("FAIL: index differs\n");
+        failures++;
+    }
+
+    if(failures){
+        printf("FAIL: %u checks failed\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Checks the indexed LUT search gives the same answer as the reference scan, and that the compact LUT
+// gives the same answer again, and compares their execution time for a range of LUT sizes.
+
+#include <platform.h>
+#include <xs1.h>
+#include <stdio.h>
+#include <xcore/hwtimer.h>
+
+#include "qadc.h"
+#include "qadc_utils.h"
+
+#define MAX_LUT_SIZE    2048
+#define NUM_TIMED       256
+
+static const unsigned lut_sizes[] = {64, 128, 256, 512, 1024, 2048};
+#define NUM_LUT_SIZES   (sizeof(lut_sizes) / sizeof(lut_sizes[0]))
+
+static uint16_t lut_up[MAX_LUT_SIZE];
+static uint16_t lut_down[MAX_LUT_SIZE];
+static uint16_t lut_compact[MAX_LUT_SIZE];
+static uint16_t timed_ticks[NUM_TIMED];
+
+// Compare both searches at every LUT value and its neighbours, which is where any difference would show
+static unsigned check_lut(qadc_pot_lut_index_t *index, qadc_pot_lut_index_t *compact_index, unsigned split_idx, unsigned num_points){
+    unsigned mismatches = 0;
+    for(int is_up = 0; is_up < 2; is_up++){
+        const uint16_t *lut = is_up ? lut_up : lut_down;
+        for(unsigned i = 0; i < num_points; i++){
+            for(int offset = -1; offset <= 1; offset++){
+                uint16_t ticks = (uint16_t)(lut[i] + offset);
+                unsigned expected = qadc_pot_lut_search_linear(lut_up, lut_down, num_points, is_up, ticks);
+                unsigned actual = qadc_pot_lut_search(index, lut_up, lut_down, num_points, is_up, ticks);
+                unsigned compact = qadc_pot_lut_search_compact(compact_index, lut_compact, split_idx, num_points, is_up, ticks);
+                if(expected != actual || expected != compact){
+                    printf("MISMATCH lut_size: %u is_up: %d ticks: %u expected: %u actual: %u compact: %u\n", num_points, is_up, ticks, expected, actual, compact);
+                    mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(void){
+    const float capacitor_f = 2200e-12;
+    const float potentiometer_ohms = 47000;
+    const float resistor_series_ohms = 470;
+    const float v_rail = 3.3;
+    const float v_thresh = 1.15;
+
+    unsigned mismatches = 0;
+
+    for(unsigned s = 0; s < NUM_LUT_SIZES; s++){
+        unsigned num_points = lut_sizes[s];
+        uint32_t max_lut_ticks_up = 0, max_lut_ticks_down = 0;
+        gen_lookup_pot(lut_up, lut_down, num_points, potentiometer_ohms, capacitor_f, resistor_series_ohms,
+                       v_rail, v_thresh, &max_lut_ticks_up, &max_lut_ticks_down);
+
+        qadc_pot_lut_index_t index;
+        uint32_t t0 = get_reference_time();
+        qadc_pot_lut_index_build(&index, lut_up, lut_down, num_points);
+        uint32_t build_ticks = get_reference_time() - t0;
+
+        unsigned split_idx = 0;
+        gen_lookup_pot_compact(lut_compact, num_points, potentiometer_ohms, capacitor_f, resistor_series_ohms,
+                               v_rail, v_thresh, &split_idx, &max_lut_ticks_up, &max_lut_ticks_down);
+        qadc_pot_lut_index_t compact_index;
+        qadc_pot_lut_index_build_compact(&compact_index, lut_compact, split_idx, num_points);
+
+        mismatches += check_lut(&index, &compact_index, split_idx, num_points);
+
+        // Spread the timed conversions evenly over the whole tick range
+        uint32_t max_ticks = max_lut_ticks_up > max_lut_ticks_down ? max_lut_ticks_up : max_lut_ticks_down;
+        for(unsigned i = 0; i < NUM_TIMED; i++){
+            timed_ticks[i] = (uint16_t)((max_ticks * i) / NUM_TIMED);
+        }
+
+        volatile unsigned sink = 0;
+        t0 = get_reference_time();
+        for(unsigned i = 0; i < NUM_TIMED; i++){
+            sink += qadc_pot_lut_search_linear(lut_up, lut_down, num_points, i & 1, timed_ticks[i]);
+        }
+        uint32_t linear_ticks = get_reference_time() - t0;
+
+        t0 = get_reference_time();
+        for(unsigned i = 0; i < NUM_TIMED; i++){
+            sink += qadc_pot_lut_search(&index, lut_up, lut_down, num_points, i & 1, timed_ticks[i]);
+        }
+        uint32_t search_ticks = get_reference_time() - t0;
+
+        t0 = get_reference_time();
+        for(unsigned i = 0; i < NUM_TIMED; i++){
+            sink += qadc_pot_lut_search_compact(&compact_index, lut_compact, split_idx, num_points, i & 1, timed_ticks[i]);
+        }
+        uint32_t compact_ticks = get_reference_time() - t0;
+
+        printf("lut_size: %u up_runs: %u down_runs: %u linear_fallback: %u index_build_ticks: %lu linear_ticks_per_conv: %lu search_ticks_per_conv: %lu compact_ticks_per_conv: %lu\n",
+                num_points, index.num_up_runs, index.num_down_runs, index.use_linear_search, build_ticks,
+                linear_ticks / NUM_TIMED, search_ticks / NUM_TIMED, compact_ticks / NUM_TIMED);
+    }
+
+    if(mismatches){
+        printf("FAIL: %u mismatches\n", mismatches);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// End to end benchmark of the QADC tasks. Run under xsim with the RC front end model in
+// tests/qadc_rc_frontend.py driving the pins, see tests/test_qadc_rc_benchmark.py. The client streams results
+// for BENCH_DURATION_TICKS after the sync pulse, collecting each frame when the task pushes that it is ready,
+// and then prints each frame with the time the push arrived.
+
+#include <platform.h>
+#include <xs1.h>
+#include <stdio.h>
+#include <xcore/hwtimer.h>
+#include <xcore/channel_streaming.h>
+
+#include "qadc.h"
+
+#ifndef BENCH_RHEO
+#define BENCH_RHEO              0
+#endif
+#ifndef BENCH_MODE
+#define BENCH_MODE              QADC_CONVERT_SEQUENTIAL
+#endif
+
+#ifndef BENCH_PORT_WIDTH
+#define BENCH_PORT_WIDTH        1
+#endif
+
+#if BENCH_PORT_WIDTH == 4
+#define NUM_ADC                 4 // Every pin of the port, as parallel potentiometer conversion needs
+#define NUM_PORTS               1
+#else
+#define NUM_ADC                 2
+#define NUM_PORTS               2
+#endif
+#define LUT_SIZE                256 // Also the number of rheostat steps
+#define FILTER_DEPTH            4
+#define HYSTERESIS              1
+
+#ifndef BENCH_INTERVAL_TICKS
+#define BENCH_INTERVAL_TICKS    20000
+#endif
+
+#define BENCH_DURATION_TICKS    (12 * XS1_TIMER_KHZ)
+#define BENCH_MAX_FRAMES        256
+#define SYNC_PULSE_TICKS        10000 // Lets the front end model relate simulator time to reference timer ticks
+
+
+#if BENCH_PORT_WIDTH == 4
+port_t p_adc[] = {XS1_PORT_4A};
+#else
+port_t p_adc[] = {XS1_PORT_1A, XS1_PORT_1B};
+#endif
+port_t p_sync = XS1_PORT_1C;
+
+static uint32_t frame_times[BENCH_MAX_FRAMES];
+static uint32_t frame_results[BENCH_MAX_FRAMES][NUM_ADC];
+
+
+DECLARE_JOB(client, (chanend_t, chanend_t, uint32_t));
+void client(chanend_t c_adc, chanend_t c_push, uint32_t time_sync){
+    size_t num_frames = 0;
+
+    // The push arrives as the scan ends so its time is the frame's arrival time
+    chan_out_word(c_adc, (uint32_t)QADC_CMD_STREAM_START);
+    while(1){
+        uint32_t word = s_chan_in_word(c_push);
+        uint32_t time_now = get_reference_time();
+        if(word == (uint32_t)QADC_PUSH_STREAM && qadc_stream_read(c_adc, frame_results[num_frames], NUM_ADC) != 0){
+            frame_times[num_frames++] = time_now - time_sync;
+        }
+        if(num_frames == BENCH_MAX_FRAMES || (int32_t)(time_now - time_sync) >= BENCH_DURATION_TICKS){
+            break;
+        }
+    }
+    chan_out_word(c_adc, (uint32_t)QADC_CMD_STREAM_STOP);
+
+    qadc_stats_t stats;
+    qadc_get_stats(c_adc, &stats, 0);
+    chan_out_word(c_adc, (uint32_t)QADC_CMD_EXIT);
+
+    // Everything the test needs is printed after the run so printing doesn't disturb the timing
+    printf("config: rheo %d mode %d num_adc %d port_width %d interval %d depth %d steps %d duration %d\n",
+            BENCH_RHEO, BENCH_MODE, NUM_ADC, BENCH_PORT_WIDTH, BENCH_INTERVAL_TICKS, FILTER_DEPTH, LUT_SIZE, BENCH_DURATION_TICKS);
+    for(size_t i = 0; i < num_frames; i++){
+        printf("frame: %u", (unsigned)frame_times[i]);
+        for(int ch = 0; ch < NUM_ADC; ch++){
+            printf(" %u", (unsigned)(frame_results[i][ch] & QADC_RESULT_MASK));
+        }
+        printf("\n");
+    }
+    unsigned hard_overshoots = 0;
+    for(int ch = 0; ch < NUM_ADC; ch++){
+        hard_overshoots += stats.hard_overshoots[ch];
+    }
+    printf("stats: missed_periods %u min_slack_ticks %d max_proc_ticks %u hard_overshoots %u\n",
+            (unsigned)stats.missed_periods, (int)stats.min_slack_ticks, (unsigned)stats.max_proc_ticks, hard_overshoots);
+}
+
+DECLARE_JOB(qadc_task_wrapper, (chanend_t, chanend_t, qadc_config_t));
+void qadc_task_wrapper(chanend_t c_adc, chanend_t c_push, qadc_config_t adc_config){
+    qadc_stats_t stats;
+#if BENCH_RHEO
+    qadc_rheo_state_t adc_rheo_state;
+    uint16_t state_buffer[QADC_RHEO_STATE_SIZE(NUM_ADC, FILTER_DEPTH)];
+    qadc_rheo_init(p_adc, NUM_ADC, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer, adc_config, &adc_rheo_state);
+    qadc_rheo_attach_stats(&adc_rheo_state, &stats);
+    qadc_rheo_attach_push(&adc_rheo_state, c_push);
+    qadc_rheo_task(c_adc, p_adc, &adc_rheo_state);
+#else
+    qadc_pot_state_t adc_pot_state;
+    uint16_t state_buffer[QADC_POT_STATE_SIZE(NUM_ADC, LUT_SIZE, FILTER_DEPTH)];
+    qadc_pot_init(p_adc, NUM_ADC, LUT_SIZE, FILTER_DEPTH, HYSTERESIS, state_buffer, adc_config, &adc_pot_state);
+    qadc_pot_attach_stats(&adc_pot_state, &stats);
+    qadc_pot_attach_push(&adc_pot_state, c_push);
+    qadc_pot_task(c_adc, p_adc, &adc_pot_state);
+#endif
+}
+
+
+int main(void){
+    // Must match the component values of the model in test_qadc_rc_benchmark.py
+    const qadc_config_t adc_config = {  .capacitor_pf = 2000,
+                                        .potentiometer_ohms = 47000,
+                                        .resistor_series_ohms = 470,
+                                        .v_rail = 3.3,
+                                        .v_thresh = 1.15,
+                                        .auto_scale = 0,
+                                        .convert_interval_ticks = BENCH_INTERVAL_TICKS,
+                                        .conversion_mode = BENCH_MODE};
+
+    channel_t c_adc = chan_alloc();
+    streaming_channel_t c_push = s_chan_alloc();
+    qadc_pre_init_c(p_adc, NUM_PORTS); // Enables one entry of p_adc per channel so pass the number of ports
+
+    // The knob trajectory starts at the rising edge of the sync pulse
+    port_enable(p_sync);
+    uint32_t time_sync = get_reference_time();
+    port_out(p_sync, 1);
+    while((int32_t)(get_reference_time() - (time_sync + SYNC_PULSE_TICKS)) < 0);
+    port_out(p_sync, 0);
+
+    PAR_JOBS(
+        PJOB(qadc_task_wrapper, (c_adc.end_a, c_push.end_a, adc_config)),
+        PJOB(client, (c_adc.end_b, c_push.end_b, time_sync))
+    );
+
+    port_disable(p_sync);
+    chan_free(c_adc);
+    // c_push is not freed as it may still hold a word pushed just before QADC_CMD_STREAM_STOP
+
+    return 0;
+}
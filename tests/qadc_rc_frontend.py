@@ -0,0 +1,153 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+# Simulated analogue front end for running the QADC tasks under xsim. Each QadcRcFrontEnd thread models the RC
+# network on one QADC pin using the transition times from design/qadc_model.py for a scripted knob trajectory.
+# The pins of a multi-bit port each have their own thread and share a PortDrive.
+# Needs Pyxsim from the XMOS test_support package.
+from pathlib import Path
+import sys
+
+import Pyxsim as px
+
+root_dir = Path(__file__).parent.parent.absolute()
+sys.path.append(str(root_dir/"design"))
+from qadc_model import qadc_rheo, qadc_pot
+
+
+class Trajectory:
+    """Piecewise constant knob position. steps is a list of (time_ticks, position) in time order where time is in
+    100 MHz reference timer ticks from the rising edge of the sync pulse and position is from 0 to 1."""
+    def __init__(self, steps):
+        self.steps = steps
+
+    def position(self, time_ticks):
+        posn = self.steps[0][1]
+        for step_time, step_posn in self.steps:
+            if time_ticks < step_time:
+                break
+            posn = step_posn
+        return posn
+
+
+class SyncClock(px.SimThread):
+    """Measures the firmware's sync pulse, which is pulse_ticks reference timer ticks wide, to relate simulator
+    time to reference timer ticks. Shared by all of the front end threads."""
+    def __init__(self, sync_port, pulse_ticks):
+        self._sync_port = sync_port
+        self._pulse_ticks = pulse_ticks
+        self.time_origin = None
+        self.time_per_tick = None
+
+    def ticks(self, sim_time):
+        return (sim_time - self.time_origin) / self.time_per_tick
+
+    def sim_time(self, ticks):
+        return self.time_origin + ticks * self.time_per_tick
+
+    def run(self):
+        xsi = self.xsi
+        self.wait_for_port_pins_change([self._sync_port])
+        rising = xsi.get_time()
+        self.wait_for_port_pins_change([self._sync_port])
+        self.time_per_tick = (xsi.get_time() - rising) / self._pulse_ticks
+        self.time_origin = rising
+
+
+class PortDrive:
+    """The levels driven onto a port by the front end threads modelling its pins. xsim drives a whole port at once
+    so each thread updates its own bit and drives the lot."""
+    def __init__(self, port):
+        self.port = port
+        self.value = 0
+
+    def drive(self, xsi, bit, level):
+        self.value = (self.value & ~(1 << bit)) | (level << bit)
+        xsi.drive_port_pins(self.port, self.value)
+
+
+class QadcRcFrontEnd(px.SimThread):
+    """Drives one QADC pin as the RC network would. While the xcore drives the pin the capacitor follows it. Once
+    released the pin keeps the charged level until the capacitor crosses the input threshold, at the time given by
+    the model for the knob position at that moment, and then reads as the resting level set by the knob. The xcore
+    driving the pin is assumed to overpower the model, as the series resistor sets the real charge current."""
+    def __init__(self, port_drive, bit, model, trajectory, clock):
+        self._port = port_drive.port
+        self._port_drive = port_drive
+        self._bit = bit
+        self._model = model
+        self._trajectory = trajectory
+        self._clock = clock
+        self._rest_level = None
+
+    def _sample(self, xsi):
+        return (xsi.sample_port_pins(self._port) >> self._bit) & 0x1
+
+    def _drive(self, xsi, level):
+        self._port_drive.drive(xsi, self._bit, level)
+
+    def _crossing(self, posn):
+        """Returns the resting pin level for a position and the ticks taken to reach it from the other level"""
+        if isinstance(self._model, qadc_pot):
+            ticks, start_high = self._model.get_ticks_and_dir_from_posn(posn)
+            return (1 if start_high else 0), ticks
+        # The rheostat always discharges to ground
+        ticks, = self._model.get_ticks_and_dir_from_posn(posn)
+        return 0, ticks
+
+    def _posn_now(self, xsi):
+        return self._trajectory.position(self._clock.ticks(xsi.get_time()))
+
+    def _idle(self, xsi):
+        """Wait predicate while the pin is at rest. Follows the knob across the threshold and returns True once the
+        xcore starts charging."""
+        if xsi.is_port_driving(self._port):
+            return True
+        rest_level, _ = self._crossing(self._posn_now(xsi))
+        if rest_level != self._rest_level:
+            self._rest_level = rest_level
+            self._drive(xsi, rest_level)
+        return False
+
+    def _charging(self, xsi):
+        """Wait predicate while the xcore drives the pin. Keeps the capacitor at the driven level and returns True once
+        the pin is released."""
+        if xsi.is_port_driving(self._port):
+            self._charged_level = self._sample(xsi)
+            return False
+        return True
+
+    def run(self):
+        xsi = self.xsi
+        self.wait(lambda x: self._clock.time_per_tick is not None)
+
+        while True:
+            self.wait(self._idle)
+            self._charged_level = self._sample(xsi)
+            self._drive(xsi, self._charged_level)
+            self.wait(self._charging)
+
+            rest_level, ticks = self._crossing(self._posn_now(xsi))
+            if rest_level == self._charged_level:
+                # Charged to the side the knob rests on so the threshold is never crossed
+                self._rest_level = rest_level
+                continue
+            self.wait_until(xsi.get_time() + ticks * self._clock.time_per_tick)
+            if not xsi.is_port_driving(self._port):
+                self._drive(xsi, rest_level)
+            self._rest_level = rest_level
+
+
+def make_model(is_rheo, capacitor_pf, r_ohms, rs_ohms, v_rail, v_thresh, n_lookup):
+    if is_rheo:
+        return qadc_rheo(capacitor_pf, r_ohms, rs_ohms, v_rail, v_thresh, n_lookup=n_lookup)
+    return qadc_pot(capacitor_pf, r_ohms, rs_ohms, v_rail, v_thresh, n_lookup=n_lookup)
+
+
+def run_with_frontend(xe, ports, sync_port, sync_pulse_ticks, model, trajectories, port_width=1):
+    """Run a firmware image under xsim with one modelled RC network per pin, each following its own trajectory.
+    Channels are numbered as the QADC numbers them, so channel n is bit n % port_width of port n // port_width."""
+    clock = SyncClock(sync_port, sync_pulse_ticks)
+    port_drives = [PortDrive(port) for port in ports]
+    frontends = [QadcRcFrontEnd(port_drives[ch // port_width], ch % port_width, model, trajectory, clock)
+                 for ch, trajectory in enumerate(trajectories)]
+    px.run_with_pyxsim(str(xe), simthreads=[clock] + frontends)
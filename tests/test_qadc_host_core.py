@@ -0,0 +1,78 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+import os
+from pathlib import Path
+import subprocess
+import numpy as np
+import sys
+
+file_dir = Path(__file__).parent.absolute()
+root_dir = Path(__file__).parent.parent.absolute()
+host_dir = file_dir/"qadc_host_core"
+build_dir = host_dir/"build"
+
+sys.path.append(str(root_dir/"design"))
+import qadc_model
+
+
+def build_host_core():
+    # Native build so uses the host compiler rather than the XMOS tools
+    assert not subprocess.run(f"cmake -B {build_dir}", shell=True, cwd=str(host_dir)).returncode
+    assert not subprocess.run(f"cmake --build {build_dir} -j", shell=True, cwd=str(host_dir)).returncode
+
+
+def test_host_core_self_check():
+    build_host_core()
+    output = subprocess.run([str(build_dir/"qadc_core_test")], capture_output=True, text=True).stdout
+    print(output)
+    assert "PASS" in output, "Host core self check failed"
+
+
+def host_lut_compare(cap_pf, res_pot, res_ser, vrail, vthresh, lut_size):
+    build_host_core()
+    lut_file = file_dir/"host_pot_lut.bin"
+    if os.path.exists(lut_file):
+        os.remove(lut_file)
+
+    cmd = f"{build_dir/'qadc_core_test'} --dump-lut {lut_size} {cap_pf} {res_pot} {res_ser} {vrail} {vthresh} {lut_file}"
+    assert not subprocess.run(cmd.split()).returncode
+
+    lut_dut = np.fromfile(lut_file, dtype=np.uint16)
+    lut_dut_up = lut_dut[:lut_size]
+    lut_dut_down = lut_dut[lut_size:]
+
+    qadc = qadc_model.qadc_pot(cap_pf, res_pot, res_ser, vrail, vthresh, lut_size)
+    lut_model_up = np.array(qadc.up, dtype=np.uint16)
+    lut_model_down = np.array(qadc.down, dtype=np.uint16)
+
+    for i in range(lut_size):
+        assert np.isclose(lut_dut_up[i], lut_model_up[i], rtol=0.001), f"ERROR: LUTs different at index {i}"
+        assert np.isclose(lut_dut_down[i], lut_model_down[i], rtol=0.001), f"ERROR: LUTs different at index {i}"
+
+    print("Host LUT test OK")
+
+
+def test_host_core_lut():
+    host_lut_compare(3000, 47000, 470, 3.3, 1.14, 1022)
+
+
+def test_host_core_benchmark():
+    build_host_core()
+    output = subprocess.run([str(build_dir/"qadc_core_benchmark"), "100000"], capture_output=True, text=True).stdout
+    print(output)
+    assert "pot_ns_per_conv" in output
+
+
+def test_host_core_benchmark_static():
+    build_host_core()
+    for variant in ["fixed", "static"]:
+        output = subprocess.run([str(build_dir/f"qadc_core_benchmark_{variant}"), "100000"], capture_output=True, text=True).stdout
+        print(output)
+        assert "rheo_ns_per_conv" in output
+
+
+if __name__ == "__main__":
+    test_host_core_self_check()
+    test_host_core_lut()
+    test_host_core_benchmark()
+    test_host_core_benchmark_static()
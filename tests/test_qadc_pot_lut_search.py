@@ -0,0 +1,28 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+import re
+from pathlib import Path
+import subprocess
+
+root_dir = Path(__file__).parent.parent.absolute()
+
+def test_pot_lut_search():
+    # expects xe to be pre-built
+    firmware_xe = root_dir/"tests/qadc_pot_lut_search/bin/qadc_pot_lut_search.xe"
+    cmd = f"xsim {firmware_xe}"
+    output = subprocess.run(cmd.split(), capture_output=True, text=True).stdout
+    print(output)
+
+    assert "PASS" in output, "Indexed LUT search does not match the linear scan"
+
+    # The index must always beat the scan for the LUT sizes we test
+    for line in output.splitlines():
+        match = re.search(r"lut_size: (\d+).*linear_ticks_per_conv: (\d+) search_ticks_per_conv: (\d+) compact_ticks_per_conv: (\d+)", line)
+        if match:
+            lut_size, linear, search, compact = (int(v) for v in match.groups())
+            print(f"lut_size {lut_size}: linear {linear * 10} ns, indexed {search * 10} ns, compact {compact * 10} ns per conversion")
+            assert search < linear, f"Indexed search slower than linear scan at lut_size {lut_size}"
+            assert compact <= search, f"Compact LUT search slower than full LUT search at lut_size {lut_size}"
+
+if __name__ == "__main__":
+    test_pot_lut_search()
@@ -0,0 +1,126 @@
+# Copyright 2024 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+# End to end throughput, latency, jitter and accuracy of the QADC tasks under xsim, with the pins driven by the
+# RC model in qadc_rc_frontend.py. Expects the configurations of tests/qadc_rc_benchmark to be pre-built.
+from pathlib import Path
+
+import numpy as np
+import pytest
+
+px = pytest.importorskip("Pyxsim", reason="Pyxsim from the XMOS test_support package is needed to model the RC network")
+from qadc_rc_frontend import Trajectory, make_model, run_with_frontend
+
+root_dir = Path(__file__).parent.parent.absolute()
+
+# Must match tests/qadc_rc_benchmark/src/main.c
+ports = ["tile[0]:XS1_PORT_1A", "tile[0]:XS1_PORT_1B"]
+ports_4bit = ["tile[0]:XS1_PORT_4A"]
+sync_port = "tile[0]:XS1_PORT_1C"
+sync_pulse_ticks = 10000
+capacitor_pf = 2000
+r_ohms = 47000
+rs_ohms = 470
+v_rail = 3.3
+v_thresh = 1.15
+
+configs = ["pot_sequential", "pot_pipelined", "pot_adaptive", "pot_parallel", "rheo_sequential", "rheo_pipelined",
+           "rheo_parallel"]
+
+
+def parse_output(output):
+    config = {}
+    times = []
+    results = []
+    stats = {}
+    for line in output.splitlines():
+        if line.startswith("config:"):
+            fields = line.split()[1:]
+            config = {k: int(v) for k, v in zip(fields[0::2], fields[1::2])}
+        elif line.startswith("frame:"):
+            values = [int(v) for v in line.split()[1:]]
+            times.append(values[0])
+            results.append(values[1:])
+        elif line.startswith("stats:"):
+            fields = line.split()[1:]
+            stats = {k: int(v) for k, v in zip(fields[0::2], fields[1::2])}
+    return config, np.array(times), np.array(results), stats
+
+
+def expected_result(model, is_rheo, posn, steps):
+    """The result the task should settle to for a knob position, from the same model which drives the pins"""
+    if is_rheo:
+        ticks, = model.get_ticks_and_dir_from_posn(posn)
+        return ticks / max(model.down) * (steps - 1)
+    return posn * (steps - 1)
+
+
+@pytest.mark.parametrize("config_name", configs)
+def test_qadc_rc_benchmark(config_name, capfd):
+    # expects xe to be pre-built
+    firmware_xe = root_dir/f"tests/qadc_rc_benchmark/bin/{config_name}/qadc_rc_benchmark_{config_name}.xe"
+    is_rheo = config_name.startswith("rheo")
+    is_adaptive = config_name.endswith("adaptive")
+    is_parallel = config_name.endswith("parallel")
+    port_width = 4 if config_name == "pot_parallel" else 1
+    num_adc = 4 if port_width == 4 else 2
+
+    # Three held positions per channel. Odd channels mirror the even ones so both directions are covered for the
+    # pot, and the pins of a wide port sit on both sides of the threshold in the same slot.
+    duration = 12 * 100000
+    step_times = [0, duration // 3, 2 * duration // 3]
+    posns = [0.3, 0.8, 0.1]
+    trajectories = [Trajectory(list(zip(step_times, posns if ch % 2 == 0 else [1 - p for p in posns])))
+                    for ch in range(num_adc)]
+
+    model = make_model(is_rheo, capacitor_pf, r_ohms, rs_ohms, v_rail, v_thresh, 1024)
+    run_with_frontend(firmware_xe, ports_4bit if port_width == 4 else ports, sync_port, sync_pulse_ticks, model,
+                      trajectories, port_width)
+    config, times, results, stats = parse_output(capfd.readouterr().out)
+    assert config["duration"] == duration, "Trajectory does not match the firmware run time"
+    assert config["num_adc"] == num_adc and config["port_width"] == port_width, "Ports do not match the firmware"
+    assert len(times) > 10, "Too few frames received"
+
+    steps = config["steps"]
+    # The parallel pot converts a whole port per interval and the parallel rheo every port
+    if is_parallel:
+        nominal_scan_ticks = (1 if is_rheo else num_adc // port_width) * config["interval"]
+    else:
+        nominal_scan_ticks = num_adc * config["interval"]
+    max_conversion_ticks = max(model.down + (model.up if not is_rheo else []))
+
+    # Scan rate. Adaptive mode has no fixed interval and should beat the fixed rate of the same components.
+    scan_rate_hz = (len(times) - 1) * 100e6 / (times[-1] - times[0])
+    nominal_rate_hz = 100e6 / nominal_scan_ticks
+    print(f"{config_name}: scan rate {scan_rate_hz:.0f} Hz (nominal {nominal_rate_hz:.0f} Hz)")
+    assert scan_rate_hz >= 0.95 * nominal_rate_hz, "Scan rate below nominal"
+
+    # Jitter. A frame is pushed when the last channel finishes converting so may vary by up to a conversion time.
+    intervals = np.diff(times)
+    jitter_ticks = np.max(np.abs(intervals - np.mean(intervals)))
+    print(f"{config_name}: frame jitter {jitter_ticks / 100:.1f} us")
+    if not is_adaptive:
+        assert jitter_ticks <= max_conversion_ticks + 1000, "Frame interval jitter larger than one conversion"
+        assert stats["missed_periods"] == 0, "Conversions overran the conversion interval"
+    assert stats["hard_overshoots"] == 0, "Conversions which never crossed the threshold"
+
+    # Latency and accuracy per step, per channel
+    tolerance = max(3, 0.02 * steps)
+    max_latency_ticks = (config["depth"] + 2) * nominal_scan_ticks
+    for ch in range(num_adc):
+        for idx, step_time in enumerate(step_times):
+            end_time = step_times[idx + 1] if idx + 1 < len(step_times) else times[-1] + 1
+            expected = expected_result(model, is_rheo, trajectories[ch].position(step_time), steps)
+            in_step = (times >= step_time) & (times < end_time)
+            settled = in_step & (np.abs(results[:, ch] - expected) <= tolerance)
+            assert np.any(settled), f"ch {ch} never settled to {expected:.0f} after step at {step_time} ticks"
+
+            latency_ticks = times[np.argmax(settled)] - step_time
+            error = np.max(np.abs(results[in_step, ch][-3:] - expected))
+            print(f"{config_name}: ch {ch} step {idx} latency {latency_ticks / 100:.0f} us settled error {error:.1f} steps")
+            if idx > 0: # The first step includes start up
+                assert latency_ticks <= max_latency_ticks, f"ch {ch} step {idx} latency too long"
+            assert error <= tolerance, f"ch {ch} step {idx} result inaccurate"
+
+
+if __name__ == "__main__":
+    pytest.main([__file__])
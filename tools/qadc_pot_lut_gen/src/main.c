@@ -0,0 +1,114 @@
+// Copyright 2024 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+// Generates a const potentiometer LUT descriptor as <name>.c and <name>.h in out_dir. Add the .c file to
+// the application and pass <name> to qadc_pot_init_shared_lut(). The tables are generated by the same
+// code that qadc_pot_init() runs on the device so conversion results are identical.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "qadc_core.h"
+
+#define ENTRIES_PER_LINE    16
+
+static void write_table(FILE *fp, const char *name, const uint16_t *table, size_t lut_size){
+    fprintf(fp, "static const uint16_t %s_ticks[%zu] = {", name, lut_size);
+    for(size_t i = 0; i < lut_size; i++){
+        if(i % ENTRIES_PER_LINE == 0){
+            fprintf(fp, "\n   ");
+        }
+        fprintf(fp, " %5u,", table[i]);
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+static void write_runs(FILE *fp, const char *field, const qadc_pot_lut_run_t *runs, unsigned num_runs){
+    fprintf(fp, "        .%s = {", field);
+    for(unsigned r = 0; r < num_runs && r < QADC_POT_LUT_MAX_RUNS; r++){
+        fprintf(fp, "{%u, %u, %u}, ", runs[r].start, runs[r].end, runs[r].is_rising);
+    }
+    fprintf(fp, "},\n");
+}
+
+
+int main(int argc, char *argv[]){
+    if(argc != 9){
+        printf("usage: %s <name> <lut_size> <cap_pf> <r_pot_ohms> <r_series_ohms> <v_rail> <v_thresh> <out_dir>\n", argv[0]);
+        return 1;
+    }
+    const char *name = argv[1];
+    const size_t lut_size = atoi(argv[2]);
+    const float capacitor_pf = atof(argv[3]);
+    const float r_pot_ohms = atof(argv[4]);
+    const float r_series_ohms = atof(argv[5]);
+    const float v_rail = atof(argv[6]);
+    const float v_thresh = atof(argv[7]);
+    const char *out_dir = argv[8];
+
+    uint16_t *buffer = malloc(QADC_POT_LUT_BUFFER_SIZE(lut_size) * sizeof(uint16_t));
+    if(lut_size < 2 || !buffer){
+        printf("Invalid lut_size %zu\n", lut_size);
+        return 1;
+    }
+
+    // The float conversion here matches qadc_pot_lut_init()
+    qadc_pot_lut_t lut;
+    qadc_pot_lut_gen(&lut, buffer, lut_size, r_pot_ohms, capacitor_pf * 1e-12, r_series_ohms, v_rail, v_thresh);
+
+    char name_upper[128];
+    size_t i = 0;
+    for(; name[i] && i < sizeof(name_upper) - 1; i++){
+        name_upper[i] = toupper((unsigned char)name[i]);
+    }
+    name_upper[i] = '\0';
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.h", out_dir, name);
+    FILE *fp = fopen(path, "wt");
+    if(!fp){
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    fprintf(fp, "// Generated by qadc_pot_lut_gen. Do not edit.\n");
+    fprintf(fp, "// capacitor_pf: %g r_pot_ohms: %g r_series_ohms: %g v_rail: %g v_thresh: %g\n\n",
+            capacitor_pf, r_pot_ohms, r_series_ohms, v_rail, v_thresh);
+    fprintf(fp, "#pragma once\n\n#include \"qadc_types.h\"\n\n");
+    fprintf(fp, "#define %s_LUT_SIZE %zu\n\n", name_upper, lut_size);
+    fprintf(fp, "extern const qadc_pot_lut_t %s;\n", name);
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "%s/%s.c", out_dir, name);
+    fp = fopen(path, "wt");
+    if(!fp){
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    fprintf(fp, "// Generated by qadc_pot_lut_gen. Do not edit.\n");
+    fprintf(fp, "// capacitor_pf: %g r_pot_ohms: %g r_series_ohms: %g v_rail: %g v_thresh: %g\n\n",
+            capacitor_pf, r_pot_ohms, r_series_ohms, v_rail, v_thresh);
+    fprintf(fp, "#include \"%s.h\"\n\n", name);
+    write_table(fp, name, lut.ticks, lut_size);
+    fprintf(fp, "const qadc_pot_lut_t %s = {\n", name);
+    fprintf(fp, "    .ticks = %s_ticks,\n", name);
+    fprintf(fp, "    .lut_size = %zu,\n", lut_size);
+    fprintf(fp, "    .split_idx = %u,\n", lut.split_idx);
+    fprintf(fp, "    .max_lut_ticks_up = %u,\n", lut.max_lut_ticks_up);
+    fprintf(fp, "    .max_lut_ticks_down = %u,\n", lut.max_lut_ticks_down);
+    fprintf(fp, "    .crossover_idx = %u,\n", lut.crossover_idx);
+    fprintf(fp, "    .index = {\n");
+    fprintf(fp, "        .num_up_runs = %u,\n", lut.index.num_up_runs);
+    fprintf(fp, "        .num_down_runs = %u,\n", lut.index.num_down_runs);
+    write_runs(fp, "up_runs", lut.index.up_runs, lut.index.num_up_runs);
+    write_runs(fp, "down_runs", lut.index.down_runs, lut.index.num_down_runs);
+    fprintf(fp, "        .use_linear_search = %u,\n", lut.index.use_linear_search);
+    fprintf(fp, "    },\n");
+    fprintf(fp, "};\n");
+    fclose(fp);
+
+    printf("Generated %s/%s.c and %s/%s.h (lut_size: %zu)\n", out_dir, name, out_dir, name, lut_size);
+    free(buffer);
+
+    return 0;
+}